@@ -30,6 +30,8 @@
 #include "conf.h"
 #include "privs.h"
 
+#include <sys/mman.h>
+
 #define MOD_DBACL_VERSION		"mod_dbacl/0.0"
 
 /* Make sure the version of proftpd is as necessary. */
@@ -45,6 +47,18 @@ module dbacl_module;
 static int dbacl_engine = FALSE;
 static int dbacl_policy = DBACL_POLICY_ALLOW;
 
+/* The session's protocol, determined once at login. */
+#define DBACL_PROTO_OTHER	0
+#define DBACL_PROTO_FTP		1
+#define DBACL_PROTO_SFTP	2
+
+static const char *dbacl_proto = NULL;
+static int dbacl_proto_id = DBACL_PROTO_OTHER;
+
+static unsigned long dbacl_opts = 0UL;
+#define DBACL_OPT_FILTER_LISTINGS	0x001
+#define DBACL_OPT_INHERIT_DIR_ROWS	0x002
+
 #define DBACL_DEFAULT_TABLE		"ftpacl"
 #define DBACL_DEFAULT_PATH_COL		"path"
 #define DBACL_DEFAULT_READ_COL		"read_acl"
@@ -67,13 +81,622 @@ static const char *dbacl_move_col = DBACL_DEFAULT_MOVE_COL;
 static const char *dbacl_view_col = DBACL_DEFAULT_VIEW_COL;
 static const char *dbacl_navigate_col = DBACL_DEFAULT_NAVIGATE_COL;
 
+/* If configured, the single integer column holding all of the ACLs of a
+ * row, packed DBACL_PACKED_BITS bits per ACL in index order, rather than
+ * using a column per ACL.
+ */
+static const char *dbacl_acls_col = NULL;
+
 static const char *dbacl_where_clause = NULL;
 
+/* Indices of the ACLs, for rows holding the values of all of the ACL
+ * columns.
+ */
+#define DBACL_ACL_READ			0
+#define DBACL_ACL_WRITE			1
+#define DBACL_ACL_DELETE		2
+#define DBACL_ACL_CREATE		3
+#define DBACL_ACL_MODIFY		4
+#define DBACL_ACL_MOVE			5
+#define DBACL_ACL_VIEW			6
+#define DBACL_ACL_NAVIGATE		7
+#define DBACL_ACL_COUNT			8
+
+/* The names of the ACLs, in index order, as used by DBACLCommandMap. */
+static const char *dbacl_acl_names[DBACL_ACL_COUNT] = {
+  "read", "write", "delete", "create", "modify", "move", "view", "navigate"
+};
+
+/* The ACL checked for each command, SITE command, and SFTP request, built
+ * when the session starts.  Commands with IDs are looked up by ID; the
+ * rest, by their (upper-cased) names.
+ */
+#define DBACL_ACL_UNMAPPED		-1
+#define DBACL_CMD_MAP_MAX_ID		128
+
+struct dbacl_cmd_map {
+  const char *name;
+  int acl;
+};
+
+static struct dbacl_cmd_map dbacl_default_cmd_map[] = {
+  { C_RETR,		DBACL_ACL_READ },
+  { "SITE CPFR",	DBACL_ACL_READ },
+
+  { C_APPE,		DBACL_ACL_WRITE },
+  { C_STOR,		DBACL_ACL_WRITE },
+  { C_STOU,		DBACL_ACL_WRITE },
+
+  { C_DELE,		DBACL_ACL_DELETE },
+  { C_RMD,		DBACL_ACL_DELETE },
+  { C_XRMD,		DBACL_ACL_DELETE },
+
+  { C_MKD,		DBACL_ACL_CREATE },
+  { C_XMKD,		DBACL_ACL_CREATE },
+  { "SITE SYMLINK",	DBACL_ACL_CREATE },
+
+  { C_MFF,		DBACL_ACL_MODIFY },
+  { C_MFMT,		DBACL_ACL_MODIFY },
+  { "SITE CHGRP",	DBACL_ACL_MODIFY },
+  { "SITE CHMOD",	DBACL_ACL_MODIFY },
+
+  { C_RNFR,		DBACL_ACL_MOVE },
+  { C_RNTO,		DBACL_ACL_MOVE },
+  { "SITE CPTO",	DBACL_ACL_MOVE },
+
+  { C_LIST,		DBACL_ACL_VIEW },
+  { C_MDTM,		DBACL_ACL_VIEW },
+  { C_MLSD,		DBACL_ACL_VIEW },
+  { C_MLST,		DBACL_ACL_VIEW },
+  { C_NLST,		DBACL_ACL_VIEW },
+  { C_SIZE,		DBACL_ACL_VIEW },
+  { C_STAT,		DBACL_ACL_VIEW },
+
+  { C_CDUP,		DBACL_ACL_NAVIGATE },
+  { C_CWD,		DBACL_ACL_NAVIGATE },
+  { C_PWD,		DBACL_ACL_NAVIGATE },
+  { C_XCUP,		DBACL_ACL_NAVIGATE },
+  { C_XCWD,		DBACL_ACL_NAVIGATE },
+  { C_XPWD,		DBACL_ACL_NAVIGATE },
+
+  { NULL, DBACL_ACL_UNMAPPED }
+};
+
+/* SFTP requests, mapped only for SFTP sessions. */
+static struct dbacl_cmd_map dbacl_default_sftp_cmd_map[] = {
+  { "COPY",		DBACL_ACL_MOVE },
+  { "FSETSTAT",		DBACL_ACL_MODIFY },
+  { "LINK",		DBACL_ACL_CREATE },
+  { "LSTAT",		DBACL_ACL_VIEW },
+  { "OPENDIR",		DBACL_ACL_VIEW },
+  { "READLINK",		DBACL_ACL_VIEW },
+  { "REALPATH",		DBACL_ACL_NAVIGATE },
+  { "RENAME",		DBACL_ACL_MOVE },
+  { "SETSTAT",		DBACL_ACL_MODIFY },
+  { "SYMLINK",		DBACL_ACL_CREATE },
+
+  { NULL, DBACL_ACL_UNMAPPED }
+};
+
+static int dbacl_cmd_map_ids[DBACL_CMD_MAP_MAX_ID];
+static pool *dbacl_cmd_map_pool = NULL;
+static pr_table_t *dbacl_cmd_map_tab = NULL;
+
+/* Values for a given path and ACL: no matching row (or no usable value in
+ * the matching row), explicitly allowed, or explicitly denied.
+ */
+#define DBACL_VALUE_NONE		0
+#define DBACL_VALUE_ALLOW		1
+#define DBACL_VALUE_DENY		2
+
+/* Each ACL in a packed column is one of the above values; the unused value
+ * (3) is treated as DBACL_VALUE_NONE.
+ */
+#define DBACL_PACKED_BITS		2
+#define DBACL_PACKED_MASK		0x3
+
+/* The number of values returned for each row: the path, and the ACL
+ * column(s).
+ */
+static unsigned int dbacl_row_ncols = DBACL_ACL_COUNT + 1;
+
+/* The values of all of the ACL columns for a path; "exists" is FALSE for
+ * a path known to have no row in the table.
+ */
+struct dbacl_row {
+  int exists;
+  unsigned char acls[DBACL_ACL_COUNT];
+};
+
+/* A path, split into its leading components (see dbacl_split_path()).
+ * Rather than copies, the components are views into the path, given by
+ * their lengths; the escaped components, for use in queries, are likewise
+ * views into the escaped path.
+ */
+struct dbacl_path {
+  const char *path;
+  size_t *lens;
+  unsigned int ncomponents;
+
+  /* Set by dbacl_escape_path(), only when needed. */
+  const char *escaped_path;
+  size_t *escaped_lens;
+};
+
+/* A path component, as listed in a query. */
+struct dbacl_path_elt {
+  struct dbacl_path *path;
+  unsigned int idx;
+};
+
+/* An append-only string buffer, for building queries. */
+struct dbacl_buf {
+  pool *pool;
+  char *data;
+  size_t len, size;
+};
+
 /* SQLNamedConnectInfo to use, if any.  Note that it would be better if
  * mod_sql.h made the MOD_SQL_DEF_CONN_NAME macro public.
  */
 static const char *dbacl_conn_name = "default";
 
+/* The mod_sql hooks, the SQLNamedQuery used for lookups, and the constant
+ * portions of the lookup queries, set up once per session.
+ */
+static cmdtable *dbacl_sql_lookup_cmdtab = NULL;
+static cmdtable *dbacl_sql_escapestr_cmdtab = NULL;
+static config_rec *dbacl_sql_query_config = NULL;
+static const char *dbacl_rows_query_prefix = NULL;
+static const char *dbacl_rows_query_join = NULL;
+static const char *dbacl_rows_query_join_suffix = NULL;
+
+/* How the rows for a list of paths are selected; see
+ * dbacl_get_rows_query().
+ */
+#define DBACL_QUERY_STRATEGY_INLIST	1
+#define DBACL_QUERY_STRATEGY_UNIONALL	2
+#define DBACL_QUERY_STRATEGY_JOIN	3
+#define DBACL_QUERY_STRATEGY_CTE	4
+
+static int dbacl_query_strategy = DBACL_QUERY_STRATEGY_INLIST;
+
+/* Maximum number of paths listed in the IN clause of a single query. */
+#define DBACL_QUERY_MAX_PATHS		256
+
+/* Whether the plan of the session's first lookup query is checked for table
+ * scans, using the SQL backend's EXPLAIN, and whether the recommended index
+ * is then created; see dbacl_check_indexes().
+ */
+#define DBACL_CHECK_INDEXES_OFF		0
+#define DBACL_CHECK_INDEXES_ON		1
+#define DBACL_CHECK_INDEXES_CREATE	2
+
+static int dbacl_check_indexes_mode = DBACL_CHECK_INDEXES_OFF;
+static const char *dbacl_check_indexes_cols = NULL;
+static int dbacl_indexes_checked = FALSE;
+
+/* Deadline, in msecs, for the SQL queries of a lookup.  mod_sql cannot
+ * interrupt a query, so a query running past the deadline is only detected
+ * once it returns; it counts as slow, and no more queries are made for that
+ * lookup.
+ */
+static unsigned int dbacl_timeout_ms = 0;
+static uint64_t dbacl_sql_deadline_ns = 0;
+
+/* Circuit breaker for SQL queries.  After the configured number of
+ * consecutive failed or slow queries, the breaker opens: no queries are
+ * made, and so DBACLPolicy applies to lookups not resolved otherwise, until
+ * the back-off period has passed.  The next query is then a probe (the
+ * breaker is half-open); if the probe succeeds, the breaker closes,
+ * otherwise it opens again.
+ */
+#define DBACL_BREAKER_DEFAULT_BACKOFF	30
+
+#define DBACL_BREAKER_CLOSED		0
+#define DBACL_BREAKER_OPEN		1
+#define DBACL_BREAKER_HALF_OPEN		2
+
+static unsigned int dbacl_breaker_max_failures = 0;
+static unsigned int dbacl_breaker_backoff = DBACL_BREAKER_DEFAULT_BACKOFF;
+static int dbacl_breaker_state = DBACL_BREAKER_CLOSED;
+static unsigned int dbacl_breaker_failures = 0;
+static uint64_t dbacl_breaker_opened_ns = 0;
+
+/* Per-session cache of table rows, keyed on path.  Since each component of
+ * a path is cached, lookups for other paths in the same tree only need to
+ * query the database for the components not yet seen.
+ */
+#define DBACL_CACHE_DEFAULT_TTL		60
+#define DBACL_CACHE_DEFAULT_MAX_ENTRIES	1024
+#define DBACL_CACHE_DEFAULT_MAX_SIZE	(256 * 1024)
+
+struct dbacl_cache_entry {
+  /* LRU list; the head is the most recently used entry. */
+  struct dbacl_cache_entry *prev, *next;
+
+  const char *key;
+  size_t keysz;
+
+  struct dbacl_row row;
+  time_t expires;
+};
+
+static int dbacl_cache_engine = FALSE;
+static unsigned int dbacl_cache_ttl = DBACL_CACHE_DEFAULT_TTL;
+static unsigned int dbacl_cache_max_entries = DBACL_CACHE_DEFAULT_MAX_ENTRIES;
+static size_t dbacl_cache_max_size = DBACL_CACHE_DEFAULT_MAX_SIZE;
+
+static pool *dbacl_cache_pool = NULL;
+static pr_table_t *dbacl_cache_tab = NULL;
+static struct dbacl_cache_entry *dbacl_cache_head = NULL;
+static struct dbacl_cache_entry *dbacl_cache_tail = NULL;
+static unsigned int dbacl_cache_count = 0;
+
+/* Bytes used by the live entries, and bytes allocated from the cache pool
+ * (live and evicted).  Pool memory cannot be freed piecemeal, so once the
+ * evicted entries use more than the configured maximum size, the live
+ * entries are copied into a fresh pool.
+ */
+static size_t dbacl_cache_size = 0;
+static size_t dbacl_cache_alloc_size = 0;
+
+/* Query for the current generation of the ACL data, e.g. a version number
+ * bumped whenever the table is changed.  When configured, cached rows are
+ * kept until the generation changes, rather than expiring.
+ */
+#define DBACL_GENERATION_DEFAULT_INTERVAL	10
+
+static const char *dbacl_generation_query = NULL;
+static unsigned int dbacl_generation_interval =
+  DBACL_GENERATION_DEFAULT_INTERVAL;
+static const char *dbacl_generation = NULL;
+static time_t dbacl_generation_checked = 0;
+
+/* Cache of table rows shared by all of the session processes, in an
+ * anonymous shared memory mapping created by the daemon process.  Entries
+ * are keyed on a hash of the principal (the table, connection, and WHERE
+ * clause with the user/group resolved) and path.
+ *
+ * The slots are grouped into buckets of DBACL_SHM_BUCKET_SIZE slots.  Each
+ * slot has a sequence number, odd while the slot is being written; readers
+ * copy a slot and then check that its sequence number has not changed, and
+ * so take no locks.  Writers claim a slot by atomically incrementing its
+ * sequence number, and simply skip caching a row if another writer got
+ * there first.
+ */
+#define DBACL_SHM_DEFAULT_MAX_ENTRIES	65536
+#define DBACL_SHM_DEFAULT_TTL		60
+#define DBACL_SHM_BUCKET_SIZE		4
+
+struct dbacl_shm_slot {
+  volatile uint32_t seqno;
+  uint32_t padding;
+
+  uint64_t key[2];
+  int64_t expires;
+
+  struct dbacl_row row;
+};
+
+static struct dbacl_shm_slot *dbacl_shm_slots = NULL;
+static unsigned int dbacl_shm_nslots = 0;
+static size_t dbacl_shm_size = 0;
+static unsigned int dbacl_shm_ttl = DBACL_SHM_DEFAULT_TTL;
+
+/* The hash state after hashing the session's principal; see
+ * dbacl_shm_get_key().
+ */
+static uint64_t dbacl_shm_principal_key[2];
+
+/* Rows resolved for paths, shared by the sessions of every server using the
+ * same Redis server (see DBACLRedis), via the core Redis API configured by
+ * mod_redis.  Each entry holds the effective row (i.e. the longest match)
+ * for a full path, rather than the row of each of its components, so that
+ * a path is resolved using a single round trip.  Keys are the path,
+ * prefixed by a hash of the session's principal.
+ */
+#define DBACL_REDIS_DEFAULT_TTL		60
+#define DBACL_REDIS_NAMESPACE		"mod_dbacl."
+
+static int dbacl_redis_engine = FALSE;
+static unsigned int dbacl_redis_ttl = DBACL_REDIS_DEFAULT_TTL;
+static const char *dbacl_redis_prefix = NULL;
+
+#ifdef PR_USE_REDIS
+static pr_redis_t *dbacl_redis = NULL;
+#endif /* PR_USE_REDIS */
+
+/* Trie of path components, for resolving the longest matching row for a
+ * path in memory.
+ */
+struct dbacl_node {
+  const char *name;
+  size_t namelen;
+
+  /* Children are kept sorted by name, for binary searches. */
+  struct dbacl_node **children;
+  unsigned int nchildren, maxchildren;
+
+  /* The number of components in the node's path, "/" having none. */
+  unsigned int depth;
+
+  struct dbacl_row row;
+};
+
+/* Rows loaded into a trie using a single query: every row for the root
+ * path and its ancestors, and every row under the root path, down to the
+ * given number of levels below it (or all levels, if zero).
+ */
+struct dbacl_preload {
+  pool *pool;
+  struct dbacl_node *trie;
+  const char *root;
+  size_t rootlen;
+  unsigned int levels;
+  time_t loaded;
+};
+
+#define DBACL_PRELOAD_NONE		0
+#define DBACL_PRELOAD_SUBTREE		1
+
+static int dbacl_preload = DBACL_PRELOAD_NONE;
+
+/* The rows for the session's home directory (see DBACLPreload). */
+static struct dbacl_preload dbacl_preloaded;
+
+/* The rows for the directory most recently entered or listed (see
+ * DBACLPrefetch), for the commands on its entries which usually follow.
+ */
+#define DBACL_PREFETCH_DEFAULT_LEVELS	1
+
+static int dbacl_prefetch_engine = FALSE;
+static unsigned int dbacl_prefetch_levels = DBACL_PREFETCH_DEFAULT_LEVELS;
+static struct dbacl_preload dbacl_prefetched;
+
+/* Pattern rows (see DBACLPatterns), whose paths contain the '*' or '?'
+ * wildcards, compiled into a trie of path components, some of which are
+ * fnmatch(3) patterns rather than names.  A pattern starting with '/'
+ * matches paths with as many components; any other pattern (e.g. "*.tmp")
+ * matches the name of a component at any depth.
+ */
+struct dbacl_pattern_node {
+  const char *name;
+  int glob;
+
+  struct dbacl_pattern_node **children;
+  unsigned int nchildren, maxchildren;
+
+  /* For choosing between patterns matching the same component: the number
+   * of non-wildcard characters in the pattern, and the order in which the
+   * pattern was loaded.
+   */
+  unsigned int nliterals;
+  unsigned int order;
+
+  struct dbacl_row row;
+};
+
+struct dbacl_patterns {
+  pool *pool;
+
+  /* The children of the root are the first components of the patterns
+   * starting with '/'; the children of the names node are the other
+   * patterns.
+   */
+  struct dbacl_pattern_node *root;
+  struct dbacl_pattern_node *names;
+  unsigned int npatterns;
+};
+
+static int dbacl_patterns_engine = FALSE;
+static const char *dbacl_patterns_clause = NULL;
+static struct dbacl_patterns dbacl_patterns;
+
+/* The rows for the paths of open SFTP file handles, keyed by path, so that
+ * the requests made using those handles (e.g. FSETSTAT) reuse the rows
+ * looked up when the handles were opened, until they are closed.
+ */
+#define DBACL_HANDLE_MAX_ENTRIES	1024
+
+struct dbacl_handle {
+  pool *pool;
+  char *path;
+  size_t pathsz;
+  unsigned int refcount;
+  struct dbacl_row row;
+};
+
+static pool *dbacl_handle_pool = NULL;
+static pr_table_t *dbacl_handle_tab = NULL;
+
+/* Bloom filter of every path in the table (as restricted by any
+ * DBACLWhereClause).  A path component which is not in the filter has no
+ * row, and so is not queried.  As everywhere else, paths are matched
+ * case-sensitively.
+ *
+ * The daemon maps a region shared by all sessions; mod_sql only connects
+ * in sessions, so the filter is built there by the first session to start,
+ * and rebuilt by the first to start once it is older than the max age (or
+ * was built for another generation).  Sessions whose DBACLWhereClause has
+ * per-user variables, or whose filter would not fit in the region, build
+ * their own filter, as do sessions using another table while the shared
+ * filter is still current.
+ */
+#define DBACL_BLOOM_DEFAULT_BITS_PER_PATH	10
+#define DBACL_BLOOM_DEFAULT_MAX_AGE		60
+#define DBACL_BLOOM_MIN_BITS			1024
+#define DBACL_BLOOM_SHM_MAX_BITS		(1ULL << 27)
+
+static int dbacl_bloom_engine = FALSE;
+static unsigned int dbacl_bloom_bits_per_path =
+  DBACL_BLOOM_DEFAULT_BITS_PER_PATH;
+static unsigned int dbacl_bloom_max_age = DBACL_BLOOM_DEFAULT_MAX_AGE;
+
+static pool *dbacl_bloom_pool = NULL;
+static unsigned char *dbacl_bloom_bits = NULL;
+static uint64_t dbacl_bloom_nbits = 0;
+static unsigned int dbacl_bloom_nhashes = 0;
+static unsigned int dbacl_bloom_npaths = 0;
+
+/* The shared filter's bits follow its header.  The seqno is odd while the
+ * filter is being built; the server key identifies the table and clause it
+ * was built from, and the key also the generation.
+ */
+struct dbacl_bloom_shm {
+  volatile uint64_t seqno;
+  uint64_t server_key[2];
+  uint64_t key[2];
+  time_t built;
+  uint64_t nbits;
+  unsigned int nhashes;
+  unsigned int npaths;
+};
+
+static struct dbacl_bloom_shm *dbacl_bloom_shm = NULL;
+static size_t dbacl_bloom_shm_size = 0;
+
+/* Whether this session uses the shared filter, and its key. */
+static int dbacl_bloom_shared = FALSE;
+static uint64_t dbacl_bloom_key[2];
+
+/* Snapshot of the table rows, compiled offline by the dbacl-snapshot tool
+ * into a trie of path components, and mapped read-only.  The file is laid
+ * out as a header, then the array of nodes (the root node first; the
+ * children of each node are contiguous, and sorted by name), then the
+ * node names.
+ */
+#define DBACL_SNAPSHOT_MAGIC		"DBACLSN1"
+#define DBACL_SNAPSHOT_VERSION		1
+
+/* How often, in seconds, to check whether the snapshot file has been
+ * replaced.
+ */
+#define DBACL_SNAPSHOT_CHECK_INTERVAL	1
+
+struct dbacl_snapshot_hdr {
+  char magic[8];
+  uint32_t version;
+  uint32_t generation;
+  uint32_t nnodes;
+  uint32_t nodes_offset;
+  uint32_t names_offset;
+  uint32_t names_size;
+};
+
+struct dbacl_snapshot_node {
+  uint32_t name_offset;
+  uint32_t name_len;
+  uint32_t first_child;
+  uint32_t nchildren;
+  uint32_t exists;
+  unsigned char acls[DBACL_ACL_COUNT];
+};
+
+/* The snapshot is found via its directory, opened before any chroot, so
+ * that replaced snapshots can still be loaded by chrooted sessions.
+ */
+static int dbacl_snapshot_dirfd = -1;
+static const char *dbacl_snapshot_name = NULL;
+
+static void *dbacl_snapshot_data = NULL;
+static size_t dbacl_snapshot_datasz = 0;
+static dev_t dbacl_snapshot_dev = 0;
+static ino_t dbacl_snapshot_ino = 0;
+static uint32_t dbacl_snapshot_generation = 0;
+static time_t dbacl_snapshot_checked = 0;
+
+/* Where the rows come from: the database, queried using mod_sql, or a
+ * local file whose rows are all loaded into a trie (see DBACLBackend).  As
+ * with the snapshot, the file is found via its directory, opened before any
+ * chroot; it is loaded again whenever its modification time changes.
+ */
+#define DBACL_BACKEND_SQL		1
+#define DBACL_BACKEND_FILE		2
+
+static int dbacl_backend = DBACL_BACKEND_SQL;
+
+/* How often, in seconds, to check whether the file has changed. */
+#define DBACL_FILE_CHECK_INTERVAL	1
+
+/* Maximum number of columns, in the file, used for finding the path and
+ * ACL columns.
+ */
+#define DBACL_FILE_MAX_COLS		64
+
+static int dbacl_file_dirfd = -1;
+static const char *dbacl_file_name = NULL;
+static struct dbacl_preload dbacl_file_rows;
+static time_t dbacl_file_mtime = 0;
+static ino_t dbacl_file_ino = 0;
+static off_t dbacl_file_size = 0;
+static time_t dbacl_file_checked = 0;
+
+/* Directories opened while listing, whose entries are filtered using the
+ * VIEW ACL.  The entries are read ahead on the first readdir(3), so that
+ * the rows for all of them can be looked up at once.
+ */
+struct dbacl_dir {
+  struct dbacl_dir *next;
+  pool *pool;
+
+  void *dirh;
+  const char *path;
+
+  struct dirent **entries;
+  unsigned int nentries, next_entry;
+  int loaded;
+};
+
+static int dbacl_listing = FALSE;
+static struct dbacl_dir *dbacl_dirs = NULL;
+
+/* Per-session timings of the phases of ACL lookups, reported by SITE DBACL
+ * STATS and logged at session end.  Each phase keeps a histogram of its
+ * times; bucket 0 counts times under 1 usec, and bucket N counts times
+ * under 2^N usecs (the last bucket counts all longer times).
+ */
+#define DBACL_STATS_PHASE_PATH		0
+#define DBACL_STATS_PHASE_ESCAPE	1
+#define DBACL_STATS_PHASE_QUERY		2
+#define DBACL_STATS_PHASE_SQL		3
+#define DBACL_STATS_PHASE_LOOKUP	4
+#define DBACL_STATS_NPHASES		5
+
+#define DBACL_STATS_NBUCKETS		24
+
+struct dbacl_stats {
+  const char *phase;
+  unsigned long count;
+  uint64_t total_ns, max_ns;
+  unsigned long buckets[DBACL_STATS_NBUCKETS];
+};
+
+static struct dbacl_stats dbacl_stats[DBACL_STATS_NPHASES] = {
+  { "path" },
+  { "escape" },
+  { "query" },
+  { "sql" },
+  { "lookup" }
+};
+
+static unsigned long dbacl_stats_allowed = 0;
+static unsigned long dbacl_stats_denied = 0;
+static unsigned long dbacl_stats_unresolved = 0;
+
+static unsigned long dbacl_stats_slow_queries = 0;
+static unsigned long dbacl_stats_skipped_queries = 0;
+static unsigned long dbacl_stats_breaker_trips = 0;
+
+static unsigned long dbacl_stats_bloom_skipped = 0;
+
+static unsigned long dbacl_stats_dir_queries = 0;
+static unsigned long dbacl_stats_dir_inherited = 0;
+
+static unsigned long dbacl_stats_redis_hits = 0;
+static unsigned long dbacl_stats_redis_misses = 0;
+static unsigned long dbacl_stats_redis_errors = 0;
+
 static const char *trace_channel = "dbacl";
 
 static cmd_rec *dbacl_cmd_create(pool *parent_pool, int argc, ...) {
@@ -105,8 +728,7 @@ static char *dbacl_escape_str(pool *p, char *str) {
   cmd_rec *sql_cmd;
   modret_t *sql_res;
 
-  /* Find the cmdtable for the sql_escapestr command. */
-  sql_cmdtab = pr_stash_get_symbol(PR_SYM_HOOK, "sql_escapestr", NULL, NULL);
+  sql_cmdtab = dbacl_sql_escapestr_cmdtab;
   if (sql_cmdtab == NULL) {
     pr_trace_msg(trace_channel, 3, "%s",
       "error: unable to find SQL hook symbol 'sql_escapestr'");
@@ -117,7 +739,10 @@ static char *dbacl_escape_str(pool *p, char *str) {
     return str;
   }
 
-  sql_cmd = dbacl_cmd_create(p, 1, pr_str_strip(p, str));
+  /* Note that the string is not stripped of whitespace; leading/trailing
+   * whitespace in a path is significant.
+   */
+  sql_cmd = dbacl_cmd_create(p, 1, str);
 
   /* Call the handler. */
   sql_res = pr_module_call(sql_cmdtab->m, sql_cmdtab->handler, sql_cmd);
@@ -133,37 +758,26 @@ static char *dbacl_escape_str(pool *p, char *str) {
   return sql_res->data;
 }
 
-static array_header *dbacl_split_path(pool *p, char *path) {
-  char *dup_path, *ptr;
-  size_t dup_pathlen;
-  array_header *elts;
-
-  dup_pathlen = strlen(path);
-  dup_path = pstrndup(p, path, dup_pathlen);
-
-  if (dup_pathlen == 1) {
-    /* Just "/" here. */
-    elts = make_array(p, 1, sizeof(char **));
-    *((char **) push_array(elts)) = pstrdup(p, "/");
-
-    return elts;
-  }
-
-  /* If the last character is a path separator, trim it off. */
-  if (dup_path[dup_pathlen-1] == '/') {
-    dup_path[dup_pathlen-1] = '\0';
-    dup_pathlen--;
-  }
+static struct dbacl_path *dbacl_split_path(pool *p, const char *path) {
+  struct dbacl_path *dp;
+  const char *ptr;
+  size_t pathlen;
+  unsigned int ncomponents = 1;
 
-  /* Start looking for path separators, just past the first character. */
-  ptr = strchr(dup_path + 1, '/');
-  if (ptr == NULL) {
-    pr_trace_msg(trace_channel, 2,
-      "unable to split path '%s': no usable path separators found", path);
+  pathlen = strlen(path);
+  if (pathlen == 0) {
     errno = EINVAL;
     return NULL;
   }
 
+  /* If the last character is a path separator (other than for "/" itself),
+   * trim it off.
+   */
+  if (pathlen > 1 &&
+      path[pathlen-1] == '/') {
+    pathlen--;
+  }
+
   /* The goal here is to a split a path like:
    *
    *  /home/user/dir/file.txt
@@ -174,25 +788,183 @@ static array_header *dbacl_split_path(pool *p, char *path) {
    *  /home/user
    *  /home/user/dir
    *  /home/user/dir/file.txt
+   *
+   * Each of which ends either at a path separator (looking just past the
+   * first character), or at the end of the path.
    */
+  for (ptr = path + 1; ptr < path + pathlen; ptr++) {
+    if (*ptr == '/') {
+      ncomponents++;
+    }
+  }
+
+  dp = pcalloc(p, sizeof(struct dbacl_path));
+  dp->path = path;
+  dp->lens = palloc(p, ncomponents * sizeof(size_t));
 
-  elts = make_array(p, 2, sizeof(char **));
+  for (ptr = path + 1; ptr < path + pathlen; ptr++) {
+    if (*ptr == '/') {
+      dp->lens[dp->ncomponents++] = ptr - path;
+    }
+  }
 
-  while (ptr != NULL) {
-    *ptr = '\0';
+  /* And don't forget the full path itself. */
+  dp->lens[dp->ncomponents++] = pathlen;
 
-    pr_signals_handle();
+  return dp;
+}
 
-    *((char **) push_array(elts)) = pstrdup(p, dup_path);
-    *ptr = '/';
+/* Escapes the full path once, rather than each of its components. */
+static int dbacl_escape_path(pool *p, struct dbacl_path *dp) {
+  const char *escaped, *ptr;
+  size_t escapedlen;
+  unsigned int n = 0;
 
-    ptr = strchr(ptr + 1, '/');
+  if (dp->escaped_path != NULL) {
+    return 0;
   }
 
-  /* And don't forget the full path itself. */
-  *((char **) push_array(elts)) = pstrdup(p, dup_path);
+  escaped = dbacl_escape_str(p,
+    pstrndup(p, dp->path, dp->lens[dp->ncomponents-1]));
+  escapedlen = strlen(escaped);
+
+  dp->escaped_lens = palloc(p, dp->ncomponents * sizeof(size_t));
+
+  /* Escaping does not add or remove path separators, so the escaped
+   * components end at the same separators as the components.
+   */
+  for (ptr = escaped + 1;
+       ptr < escaped + escapedlen && n < dp->ncomponents - 1;
+       ptr++) {
+    if (*ptr == '/') {
+      dp->escaped_lens[n++] = ptr - escaped;
+    }
+  }
+
+  if (n != dp->ncomponents - 1) {
+    pr_trace_msg(trace_channel, 3,
+      "escaped path '%s' has unexpected number of components", escaped);
+    errno = EINVAL;
+    return -1;
+  }
+
+  dp->escaped_lens[n] = escapedlen;
+  dp->escaped_path = escaped;
+
+  return 0;
+}
+
+static void dbacl_buf_init(pool *p, struct dbacl_buf *buf, size_t size) {
+  buf->pool = p;
+  buf->size = size > 0 ? size : 1;
+  buf->data = palloc(p, buf->size);
+  buf->data[0] = '\0';
+  buf->len = 0;
+}
+
+static void dbacl_buf_append(struct dbacl_buf *buf, const char *str,
+    size_t len) {
+  if (buf->len + len + 1 > buf->size) {
+    size_t size;
+    char *data;
+
+    /* Pool memory cannot be reallocated; doubling the size keeps the total
+     * memory used, and copying done, linear in the final length.
+     */
+    size = buf->size * 2;
+    while (size < buf->len + len + 1) {
+      size *= 2;
+    }
+
+    data = palloc(buf->pool, size);
+    memcpy(data, buf->data, buf->len);
+
+    buf->data = data;
+    buf->size = size;
+  }
+
+  memcpy(buf->data + buf->len, str, len);
+  buf->len += len;
+  buf->data[buf->len] = '\0';
+}
+
+static void dbacl_buf_appendstr(struct dbacl_buf *buf, const char *str) {
+  dbacl_buf_append(buf, str, strlen(str));
+}
+
+/* Appends the given (escaped) path component as a quoted SQL string. */
+static void dbacl_buf_append_elt(struct dbacl_buf *buf,
+    struct dbacl_path_elt *elt) {
+  dbacl_buf_append(buf, "'", 1);
+  dbacl_buf_append(buf, elt->path->escaped_path,
+    elt->path->escaped_lens[elt->idx]);
+  dbacl_buf_append(buf, "'", 1);
+}
+
+/* Statistics routines
+ */
+
+static uint64_t dbacl_stats_now(void) {
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+    return 0;
+  }
+
+  return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/* Records, and returns, the time taken by a phase which began at the given
+ * time.
+ */
+static uint64_t dbacl_stats_add(int phase, uint64_t start_ns) {
+  struct dbacl_stats *stats;
+  uint64_t now_ns, elapsed_ns = 0, usecs;
+  unsigned int bucket = 0;
+
+  now_ns = dbacl_stats_now();
+  if (now_ns > start_ns) {
+    elapsed_ns = now_ns - start_ns;
+  }
+
+  stats = &(dbacl_stats[phase]);
+  stats->count++;
+  stats->total_ns += elapsed_ns;
+
+  if (elapsed_ns > stats->max_ns) {
+    stats->max_ns = elapsed_ns;
+  }
+
+  for (usecs = elapsed_ns / 1000; usecs > 0; usecs >>= 1) {
+    if (bucket == DBACL_STATS_NBUCKETS - 1) {
+      break;
+    }
+
+    bucket++;
+  }
+
+  stats->buckets[bucket]++;
+  return elapsed_ns;
+}
 
-  return elts;
+/* Returns the upper bound, in usecs, of the histogram bucket holding the
+ * given percentile of a phase's times.
+ */
+static unsigned long dbacl_stats_get_percentile(struct dbacl_stats *stats,
+    unsigned int pct) {
+  register unsigned int i;
+  unsigned long target, seen = 0;
+
+  target = ((stats->count * pct) + 99) / 100;
+
+  for (i = 0; i < DBACL_STATS_NBUCKETS - 1; i++) {
+    seen += stats->buckets[i];
+    if (seen >= target) {
+      break;
+    }
+  }
+
+  return 1UL << i;
 }
 
 static char *dbacl_get_path_skip_opts(cmd_rec *cmd) {
@@ -250,18 +1022,47 @@ static char *dbacl_get_path_skip_opts(cmd_rec *cmd) {
   return path;
 }
 
-static char *dbacl_get_path(cmd_rec *cmd, const char *proto) {
-  char *path = NULL, *abs_path = NULL;
+/* Resolves the given path, as seen by the client, to the absolute path
+ * used in the ACL table.
+ */
+static char *dbacl_get_abs_path(cmd_rec *cmd, const char *path) {
+  char *abs_path;
+  uint64_t start_ns;
+
+  start_ns = dbacl_stats_now();
+  abs_path = dir_abs_path(cmd->tmp_pool, path, TRUE);
+  dbacl_stats_add(DBACL_STATS_PHASE_PATH, start_ns);
+
+  if (abs_path == NULL) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 1, "error resolving '%s': %s", path,
+      strerror(xerrno));
+
+    errno = EINVAL;
+    return NULL;
+  }
+
+  pr_trace_msg(trace_channel, 17, "resolved path '%s' to '%s'", path, abs_path);
+  return abs_path;
+}
+
+static char *dbacl_get_path(cmd_rec *cmd) {
+  char *path = NULL;
 
-  if (strncasecmp(proto, "ftp", 4) == 0 ||
-      strncasecmp(proto, "ftps", 5) == 0) {
+  if (dbacl_proto_id == DBACL_PROTO_FTP) {
     if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0) {
+        register unsigned int i = 2;
+
+        /* Most SITE commands (e.g. CPFR, CPTO) take just a path. */
         if (strncasecmp(cmd->argv[1], "CHMOD", 6) == 0 ||
             strncasecmp(cmd->argv[1], "CHGRP", 6) == 0) {
-          register unsigned int i;
+          i = 3;
+        }
 
+        if (i < cmd->argc) {
           path = "";
-          for (i = 3; i < cmd->argc; i++) {
+          for (; i < cmd->argc; i++) {
             path = pstrcat(cmd->tmp_pool, path, *path ? " " : "", cmd->argv[i],
               NULL);
           }
@@ -279,110 +1080,229 @@ static char *dbacl_get_path(cmd_rec *cmd, const char *proto) {
       path = cmd->arg;
     }
 
-  } else if (strncasecmp(proto, "sftp", 5) == 0) {
+  } else if (dbacl_proto_id == DBACL_PROTO_SFTP) {
     path = cmd->arg;
 
   } else {
     pr_trace_msg(trace_channel, 1,
-      "unable to get path from command: unsupported protocol '%s'", proto);
+      "unable to get path from command: unsupported protocol '%s'",
+      dbacl_proto);
     errno = EINVAL;
     return NULL;
   }
 
-  abs_path = dir_abs_path(cmd->tmp_pool, path, TRUE);
-  if (abs_path == NULL) {
-    int xerrno = errno;
-
-    pr_trace_msg(trace_channel, 1, "error resolving '%s': %s", path,
-      strerror(xerrno));
-
+  if (path == NULL) {
+    pr_trace_msg(trace_channel, 1,
+      "unable to get path from command '%s'", cmd->argv[0]);
     errno = EINVAL;
     return NULL;
   }
 
-  pr_trace_msg(trace_channel, 17, "resolved path '%s' to '%s'", path, abs_path);
-  return abs_path;
+  return dbacl_get_abs_path(cmd, path);
 }
 
-static const char *dbacl_get_column(cmd_rec *cmd, const char *proto) {
-  const char *col = NULL;
+/* Gets the absolute path(s) for the command.  Commands involving two paths
+ * (RNTO, SITE CPTO, SITE SYMLINK, and SFTP LINK/SYMLINK/RENAME/COPY) have
+ * both paths returned, the source path first, so that both can be resolved
+ * together.
+ */
+static int dbacl_get_paths(cmd_rec *cmd, char **paths, unsigned int *npaths) {
+  const char *src_path = NULL;
+
+  *npaths = 0;
+
+  if (dbacl_proto_id == DBACL_PROTO_SFTP &&
+      (pr_cmd_strcmp(cmd, "SYMLINK") == 0 ||
+       pr_cmd_strcmp(cmd, "LINK") == 0 ||
+       pr_cmd_strcmp(cmd, "RENAME") == 0 ||
+       pr_cmd_strcmp(cmd, "COPY") == 0)) {
+    char *arg, *ptr;
+
+    arg = pstrdup(cmd->tmp_pool, cmd->arg);
+    ptr = strchr(arg, '\t');
+    if (ptr == NULL) {
+      if (pr_cmd_strcmp(cmd, "RENAME") != 0 &&
+          pr_cmd_strcmp(cmd, "COPY") != 0) {
+        /* Malformed SFTP SYMLINK/LINK cmd_rec. */
+        pr_trace_msg(trace_channel, 1,
+          "malformed SFTP %s request, ignoring", (char *) cmd->argv[0]);
+        errno = EINVAL;
+        return -1;
+      }
 
-  if (pr_cmd_cmp(cmd, PR_CMD_RETR_ID) == 0) {
-    col = dbacl_read_col;
+    } else {
+      *ptr = '\0';
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_STOR_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_APPE_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_STOU_ID) == 0) {
-    col = dbacl_write_col;
+      paths[0] = dbacl_get_abs_path(cmd, arg);
+      if (paths[0] == NULL) {
+        return -1;
+      }
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_DELE_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_RMD_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_XRMD_ID) == 0) {
-    col = dbacl_delete_col;
+      paths[1] = dbacl_get_abs_path(cmd, ptr + 1);
+      if (paths[1] == NULL) {
+        return -1;
+      }
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_MKD_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_XMKD_ID) == 0) {
-    col = dbacl_create_col;
+      *npaths = 2;
+      return 0;
+    }
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_MFMT_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_MFF_ID) == 0) {
-    col = dbacl_modify_col;
+  } else if (dbacl_proto_id == DBACL_PROTO_FTP) {
+    if (pr_cmd_cmp(cmd, PR_CMD_RNTO_ID) == 0) {
+      /* The path given to RNFR. */
+      src_path = session.xfer.path;
+
+    } else if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0 &&
+               cmd->argc == 4 &&
+               strncasecmp(cmd->argv[1], "SYMLINK", 8) == 0) {
+      /* SITE SYMLINK target link, as handled by mod_site_misc. */
+      paths[0] = dbacl_get_abs_path(cmd, cmd->argv[2]);
+      if (paths[0] == NULL) {
+        return -1;
+      }
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_RNFR_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_RNTO_ID) == 0) {
-    col = dbacl_move_col;
+      paths[1] = dbacl_get_abs_path(cmd, cmd->argv[3]);
+      if (paths[1] == NULL) {
+        return -1;
+      }
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_LIST_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_MLSD_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_MLST_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_NLST_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_STAT_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_MDTM_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_SIZE_ID) == 0) {
-    col = dbacl_view_col;
-
-  } else if (pr_cmd_cmp(cmd, PR_CMD_CDUP_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_XCUP_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_CWD_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_XCWD_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_PWD_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_XPWD_ID) == 0) {
-    col = dbacl_navigate_col;
+      *npaths = 2;
+      return 0;
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0) {
-    if (strncasecmp(cmd->argv[1], "CHMOD", 6) == 0 ||
-        strncasecmp(cmd->argv[1], "CHGRP", 6) == 0) {
-      col = dbacl_modify_col;
+    } else if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0 &&
+               strncasecmp(cmd->argv[1], "CPTO", 5) == 0) {
+      /* The path given to SITE CPFR, as noted by mod_copy. */
+      src_path = pr_table_get(session.notes, "mod_copy.cpfr-path", NULL);
+    }
+  }
+
+  if (src_path != NULL) {
+    paths[*npaths] = dbacl_get_abs_path(cmd, src_path);
+    if (paths[*npaths] == NULL) {
+      return -1;
+    }
+
+    (*npaths)++;
+  }
+
+  paths[*npaths] = dbacl_get_path(cmd);
+  if (paths[*npaths] == NULL) {
+    return -1;
+  }
+
+  (*npaths)++;
+  return 0;
+}
+
+/* Command map routines
+ */
+
+static char *dbacl_cmd_map_key(pool *p, const char *name, const char *arg) {
+  char *key, *ptr;
+
+  key = pstrcat(p, name, arg != NULL ? " " : "", arg, NULL);
+  for (ptr = key; *ptr; ptr++) {
+    *ptr = toupper((int) *ptr);
+  }
+
+  return key;
+}
+
+static void dbacl_cmd_map_set(const char *name, int acl) {
+  int cmd_id, *value;
+  char *key;
+
+  cmd_id = pr_cmd_get_id(name);
+  if (cmd_id > 0 &&
+      cmd_id < DBACL_CMD_MAP_MAX_ID) {
+    dbacl_cmd_map_ids[cmd_id] = acl;
+    return;
+  }
+
+  key = dbacl_cmd_map_key(dbacl_cmd_map_pool, name, NULL);
+  (void) pr_table_kremove(dbacl_cmd_map_tab, key, strlen(key) + 1, NULL);
+
+  value = palloc(dbacl_cmd_map_pool, sizeof(int));
+  *value = acl;
+
+  (void) pr_table_kadd(dbacl_cmd_map_tab, key, strlen(key) + 1, value,
+    sizeof(int));
+}
+
+/* Builds the command map: the default mappings, then those configured using
+ * DBACLCommandMap, in order, each replacing any earlier mapping of the same
+ * command.
+ */
+static void dbacl_cmd_map_init(void) {
+  register unsigned int i;
+  config_rec *c;
+
+  dbacl_cmd_map_pool = make_sub_pool(session.pool);
+  pr_pool_tag(dbacl_cmd_map_pool, MOD_DBACL_VERSION " command map pool");
+
+  dbacl_cmd_map_tab = pr_table_alloc(dbacl_cmd_map_pool, 0);
+
+  for (i = 0; i < DBACL_CMD_MAP_MAX_ID; i++) {
+    dbacl_cmd_map_ids[i] = DBACL_ACL_UNMAPPED;
+  }
 
-    } else if (strncasecmp(cmd->argv[1], "CPTO", 5) == 0) {
-      col = dbacl_move_col;
+  for (i = 0; dbacl_default_cmd_map[i].name != NULL; i++) {
+    dbacl_cmd_map_set(dbacl_default_cmd_map[i].name,
+      dbacl_default_cmd_map[i].acl);
+  }
+
+  if (dbacl_proto_id == DBACL_PROTO_SFTP) {
+    for (i = 0; dbacl_default_sftp_cmd_map[i].name != NULL; i++) {
+      dbacl_cmd_map_set(dbacl_default_sftp_cmd_map[i].name,
+        dbacl_default_sftp_cmd_map[i].acl);
     }
+  }
 
-  } else if (strncasecmp(proto, "sftp", 5) == 0) {
-    /* Mapping of SFTP requests to ACLs */
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLCommandMap", FALSE);
+  while (c != NULL) {
+    pr_signals_handle();
 
-    if (pr_cmd_strcmp(cmd, "LSTAT") == 0 ||
-        pr_cmd_strcmp(cmd, "OPENDIR") == 0 ||
-        pr_cmd_strcmp(cmd, "READLINK") == 0) {
-      col = dbacl_view_col;
+    pr_trace_msg(trace_channel, 15, "mapping command '%s' to %s ACL",
+      (char *) c->argv[0], *((int *) c->argv[1]) != DBACL_ACL_UNMAPPED ?
+      dbacl_acl_names[*((int *) c->argv[1])] : "no");
+    dbacl_cmd_map_set(c->argv[0], *((int *) c->argv[1]));
 
-    } else if (pr_cmd_strcmp(cmd, "REALPATH") == 0) {
-      col = dbacl_navigate_col;
+    c = find_config_next(c, c->next, CONF_PARAM, "DBACLCommandMap", FALSE);
+  }
+}
 
-    } else if (pr_cmd_strcmp(cmd, "SETSTAT") == 0 ||
-               pr_cmd_strcmp(cmd, "FSETSTAT") == 0) {
-      col = dbacl_modify_col;
+/* Returns the index of the ACL to check for the command, or
+ * DBACL_ACL_UNMAPPED.
+ */
+static int dbacl_cmd_map_get(cmd_rec *cmd) {
+  const int *value;
+  char *key;
 
-    } else if (pr_cmd_strcmp(cmd, "RENAME") == 0) {
-      col = dbacl_move_col;
+  if (cmd->cmd_id == 0) {
+    cmd->cmd_id = pr_cmd_get_id(cmd->argv[0]);
+  }
 
-    } else if (pr_cmd_strcmp(cmd, "SYMLINK") == 0 ||
-               pr_cmd_strcmp(cmd, "LINK") == 0) {
-      col = dbacl_create_col;
+  if (cmd->cmd_id == PR_CMD_SITE_ID) {
+    if (cmd->argc < 2) {
+      return DBACL_ACL_UNMAPPED;
     }
+
+    key = dbacl_cmd_map_key(cmd->tmp_pool, cmd->argv[0], cmd->argv[1]);
+
+  } else if (cmd->cmd_id > 0 &&
+             cmd->cmd_id < DBACL_CMD_MAP_MAX_ID) {
+    return dbacl_cmd_map_ids[cmd->cmd_id];
+
+  } else {
+    key = dbacl_cmd_map_key(cmd->tmp_pool, cmd->argv[0], NULL);
   }
 
-  return col;
+  value = pr_table_kget(dbacl_cmd_map_tab, key, strlen(key) + 1, NULL);
+  if (value == NULL) {
+    return DBACL_ACL_UNMAPPED;
+  }
+
+  return *value;
 }
 
 static int dbacl_is_boolean(const char *str) {
@@ -412,431 +1332,5137 @@ static int dbacl_is_boolean(const char *str) {
   return res;
 }
 
-static int dbacl_get_row(pool *p, const char *acl_col,
-    array_header *path_elts) {
-  register unsigned int i;
-  cmd_rec *sql_cmd = NULL;
-  char *query = NULL, *query_name = NULL, **elts, **values;
-  array_header *list_elts, *sql_data = NULL;
-  cmdtable *sql_cmdtab = NULL;
-  modret_t *sql_res = NULL;
-
-  /* Sanitize the path components in the list we'll be used, to avoid any
-   * SQL injection attacks.
-   */
-  list_elts = make_array(p, path_elts->nelts, sizeof(char **));
-  elts = path_elts->elts;
-  for (i = 0; i < path_elts->nelts; i++) {
-    *((char **) push_array(list_elts)) = dbacl_escape_str(p, elts[i]);
+/* Returns the list of the path column and all of the ACL columns, in
+ * DBACL_ACL index order, for use in queries returning entire rows.
+ */
+static char *dbacl_get_row_cols(pool *p) {
+  if (dbacl_acls_col != NULL) {
+    return pstrcat(p, dbacl_path_col, ", ", dbacl_acls_col, NULL);
   }
 
-  /* SQL query to use:
-   *
-   *  SELECT acl_col FROM dbacl_table
-   *    WHERE
-   *      path_col IN ($list)
-   *      ORDER BY LENGTH(path_col)
-   *      DESC LIMIT 1;
-   *
-   * Expand "($list)" to e.g.
-   *
-   *   ('/home', '/home/user', '/home/user/dir', '/home/user/dir/file.txt')
-   */
+  return pstrcat(p, dbacl_path_col, ", ", dbacl_read_col, ", ",
+    dbacl_write_col, ", ", dbacl_delete_col, ", ", dbacl_create_col, ", ",
+    dbacl_modify_col, ", ", dbacl_move_col, ", ", dbacl_view_col, ", ",
+    dbacl_navigate_col, NULL);
+}
 
-  /* Default schema:
-   *
-   *  CREATE TABLE dbacl (
-   *    user VARCHAR NOT NULL,
-   *    group VARCHAR NOT NULL,
-   *    path VARCHAR NOT NULL,
-   *    create BOOLEAN,
-   *    modify BOOLEAN,
-   *    write BOOLEAN,
-   *    read BOOLEAN,
-   *    delete BOOLEAN,
-   *    move BOOLEAN,
-   *    view BOOLEAN,
-   *  );
-   */
+static int dbacl_sql_init(pool *p) {
+  char *query_name;
 
-  /* Find the cmdtable for the sql_lookup command. */
-  sql_cmdtab = pr_stash_get_symbol(PR_SYM_HOOK, "sql_lookup", NULL, NULL);
-  if (sql_cmdtab == NULL) {
+  /* Only the list of paths varies from one lookup query to the next. */
+  dbacl_rows_query_prefix = pstrcat(session.pool, "SELECT ",
+    dbacl_get_row_cols(p), " FROM ", dbacl_table, " WHERE ", NULL);
+  dbacl_rows_query_join = pstrcat(session.pool, "SELECT ",
+    dbacl_get_row_cols(p), " FROM ", dbacl_table, " JOIN ", NULL);
+  dbacl_rows_query_join_suffix = pstrcat(session.pool, " ON ",
+    dbacl_path_col, " = dbacl_path", NULL);
+
+  if (dbacl_where_clause != NULL) {
+    dbacl_rows_query_prefix = pstrcat(session.pool, dbacl_rows_query_prefix,
+      "(", dbacl_where_clause, ") AND ", NULL);
+    dbacl_rows_query_join_suffix = pstrcat(session.pool,
+      dbacl_rows_query_join_suffix, " WHERE (", dbacl_where_clause, ")",
+      NULL);
+  }
+
+  /* Find the cmdtables for the sql_lookup and sql_escapestr commands. */
+  dbacl_sql_lookup_cmdtab = pr_stash_get_symbol(PR_SYM_HOOK, "sql_lookup",
+    NULL, NULL);
+  if (dbacl_sql_lookup_cmdtab == NULL) {
     pr_trace_msg(trace_channel, 3, "%s",
       "error: unable to find SQL hook symbol 'sql_lookup'");
     errno = EPERM;
     return -1;
   }
 
-  /* Build up the query to use, including WHERE clause. */
-  query = pstrcat(p, acl_col, " FROM ", dbacl_table, " WHERE ", NULL);
+  dbacl_sql_escapestr_cmdtab = pr_stash_get_symbol(PR_SYM_HOOK,
+    "sql_escapestr", NULL, NULL);
+  if (dbacl_sql_escapestr_cmdtab == NULL) {
+    pr_trace_msg(trace_channel, 3, "%s",
+      "error: unable to find SQL hook symbol 'sql_escapestr'");
+  }
+
+  /* Cheat, and programmatically create a SQLNamedQuery for our queries.  The
+   * query text is set for each lookup; this way, the server's config list
+   * does not change for every lookup.  It is a FREEFORM query, rather than
+   * a SELECT, so that queries need not begin with "SELECT" (e.g. those
+   * using a WITH clause).
+   */
+  query_name = pstrcat(p, "SQLNamedQuery_", MOD_DBACL_VERSION, NULL);
+  dbacl_sql_query_config = add_config_param_set(&(main_server->conf),
+    query_name, 3, "FREEFORM", "", dbacl_conn_name);
+
+  return 0;
+}
 
-  if (dbacl_where_clause != NULL) {
-    query = pstrcat(p, query, "(", dbacl_where_clause, ") AND ", NULL);
+/* Circuit breaker routines
+ */
+
+static int dbacl_breaker_allow(void) {
+  uint64_t backoff_ns;
+
+  if (dbacl_breaker_state != DBACL_BREAKER_OPEN) {
+    return TRUE;
   }
 
-  query = pstrcat(p, query, dbacl_path_col, " IN (", NULL);
+  backoff_ns = (uint64_t) dbacl_breaker_backoff * 1000000000ULL;
+  if (dbacl_stats_now() - dbacl_breaker_opened_ns < backoff_ns) {
+    return FALSE;
+  }
 
-  elts = list_elts->elts;
-  for (i = 0; i < list_elts->nelts; i++) {
-    query = pstrcat(p, query, "'", elts[i], "'", NULL);
+  pr_trace_msg(trace_channel, 5,
+    "circuit breaker back-off of %u secs has passed, probing database",
+    dbacl_breaker_backoff);
+  dbacl_breaker_state = DBACL_BREAKER_HALF_OPEN;
 
-    if (i != (list_elts->nelts-1)) {
-      /* Only append the comma separator if we are not the last item in the
-       * list.
-       */
-      query = pstrcat(p, query, ", ", NULL);
-    }
+  return TRUE;
+}
+
+static void dbacl_breaker_succeeded(void) {
+  if (dbacl_breaker_state != DBACL_BREAKER_CLOSED) {
+    pr_log_pri(PR_LOG_NOTICE, MOD_DBACL_VERSION
+      ": ACL database probe succeeded, resuming SQL lookups");
+  }
+
+  dbacl_breaker_state = DBACL_BREAKER_CLOSED;
+  dbacl_breaker_failures = 0;
+}
+
+static void dbacl_breaker_failed(void) {
+  dbacl_breaker_failures++;
+
+  if (dbacl_breaker_max_failures == 0) {
+    return;
   }
 
-  query = pstrcat(p, query, ") ORDER BY LENGTH(", dbacl_path_col,
-    ") DESC LIMIT 1", NULL);
+  if (dbacl_breaker_state == DBACL_BREAKER_HALF_OPEN) {
+    pr_trace_msg(trace_channel, 5,
+      "circuit breaker probe failed, skipping SQL lookups for %u secs",
+      dbacl_breaker_backoff);
 
-  pr_trace_msg(trace_channel, 7, "constructed query '%s'", query);
+  } else if (dbacl_breaker_failures >= dbacl_breaker_max_failures) {
+    pr_log_pri(PR_LOG_NOTICE, MOD_DBACL_VERSION
+      ": %u consecutive failed or slow ACL database queries, skipping SQL "
+      "lookups for %u secs", dbacl_breaker_failures, dbacl_breaker_backoff);
 
-  /* Cheat, and programmatically create a SQLNamedQuery for this query. */
-  query_name = pstrcat(p, "SQLNamedQuery_", MOD_DBACL_VERSION, NULL);
+  } else {
+    return;
+  }
+
+  dbacl_breaker_state = DBACL_BREAKER_OPEN;
+  dbacl_breaker_opened_ns = dbacl_stats_now();
+  dbacl_stats_breaker_trips++;
+}
+
+static array_header *dbacl_sql_lookup(pool *p, const char *query) {
+  cmd_rec *sql_cmd = NULL;
+  modret_t *sql_res = NULL;
+  uint64_t start_ns, elapsed_ns;
+
+  if (dbacl_sql_lookup_cmdtab == NULL ||
+      dbacl_sql_query_config == NULL) {
+    pr_trace_msg(trace_channel, 3, "%s",
+      "error: unable to find SQL hook symbol 'sql_lookup'");
+    errno = EPERM;
+    return NULL;
+  }
+
+  if (dbacl_sql_deadline_ns > 0 &&
+      dbacl_stats_now() >= dbacl_sql_deadline_ns) {
+    pr_trace_msg(trace_channel, 5,
+      "DBACLTimeout of %u ms has passed, skipping SQL query '%s'",
+      dbacl_timeout_ms, query);
+    dbacl_stats_skipped_queries++;
+
+    errno = ETIMEDOUT;
+    return NULL;
+  }
+
+  if (!dbacl_breaker_allow()) {
+    pr_trace_msg(trace_channel, 5,
+      "circuit breaker open, skipping SQL query '%s'", query);
+    dbacl_stats_skipped_queries++;
+
+    errno = EAGAIN;
+    return NULL;
+  }
 
-  add_config_param_set(&(main_server->conf), query_name, 3, "SELECT", query,
-    dbacl_conn_name);
+  dbacl_sql_query_config->argv[1] = (char *) query;
 
+  /* Note that a new cmd_rec is needed for each call; mod_sql allocates
+   * from its pool.
+   */
   sql_cmd = dbacl_cmd_create(p, 2, "sql_lookup", MOD_DBACL_VERSION);
 
   /* Call the handler. */
-  sql_res = pr_module_call(sql_cmdtab->m, sql_cmdtab->handler, sql_cmd);
+  start_ns = dbacl_stats_now();
+  sql_res = pr_module_call(dbacl_sql_lookup_cmdtab->m,
+    dbacl_sql_lookup_cmdtab->handler, sql_cmd);
+  elapsed_ns = dbacl_stats_add(DBACL_STATS_PHASE_SQL, start_ns);
+
+  /* The query text belongs to the caller's pool. */
+  dbacl_sql_query_config->argv[1] = "";
 
   /* Check the results. */
   if (MODRET_ISDECLINED(sql_res) ||
       MODRET_ISERROR(sql_res)) {
     pr_trace_msg(trace_channel, 2,
       "error processing SQL query '%s', check SQLLogFile for details", query);
+    dbacl_breaker_failed();
+
     errno = EPERM;
-    return -1;
+    return NULL;
   }
 
-  /* Remove the SQLNamedQuery. */
-  (void) remove_config(main_server->conf, query_name, FALSE);
-
-  sql_data = (array_header *) sql_res->data;
+  /* A slow query's results are still used; the time has already been
+   * spent.  Queries made outside of a lookup (e.g. when preloading rows)
+   * have no deadline, but are still checked against the timeout.
+   */
+  if ((dbacl_sql_deadline_ns > 0 &&
+       dbacl_stats_now() > dbacl_sql_deadline_ns) ||
+      (dbacl_sql_deadline_ns == 0 &&
+       dbacl_timeout_ms > 0 &&
+       elapsed_ns > (uint64_t) dbacl_timeout_ms * 1000000ULL)) {
+    pr_trace_msg(trace_channel, 3,
+      "SQL query '%s' took %lu ms, exceeding DBACLTimeout of %u ms", query,
+      (unsigned long) (elapsed_ns / 1000000), dbacl_timeout_ms);
+    dbacl_stats_slow_queries++;
+    dbacl_breaker_failed();
 
-  if (sql_data->nelts == 0) {
-    pr_trace_msg(trace_channel, 8, "query '%s' returned no matching rows",
-      query);
-    errno = ENOENT;
-    return -1;
+  } else {
+    dbacl_breaker_succeeded();
   }
 
-  if (sql_data->nelts != 1) {
-    pr_trace_msg(trace_channel, 5,
-      "query '%s' returned incorrect number of values (%d)", query,
-      sql_data->nelts);
-    errno = EINVAL;
-    return -1;
+  return (array_header *) sql_res->data;
+}
+
+/* Session cache routines
+ */
+
+static size_t dbacl_cache_entry_size(struct dbacl_cache_entry *ce) {
+  return sizeof(struct dbacl_cache_entry) + ce->keysz;
+}
+
+static void dbacl_cache_unlink(struct dbacl_cache_entry *ce) {
+  if (ce->prev != NULL) {
+    ce->prev->next = ce->next;
+
+  } else {
+    dbacl_cache_head = ce->next;
   }
 
-  values = (char **) sql_data->elts;
+  if (ce->next != NULL) {
+    ce->next->prev = ce->prev;
 
-  pr_trace_msg(trace_channel, 8,
-    "query '%s' returned value '%s'", query, values[0]);
+  } else {
+    dbacl_cache_tail = ce->prev;
+  }
 
-  return dbacl_is_boolean(values[0]);
+  ce->prev = ce->next = NULL;
 }
 
-static int dbacl_get_path_acl(cmd_rec *cmd, const char *acl_col, char *path,
-    int *policy) {
-  array_header *path_elts;
-  int res;
+static void dbacl_cache_link(struct dbacl_cache_entry *ce) {
+  ce->prev = NULL;
+  ce->next = dbacl_cache_head;
 
-  path_elts = dbacl_split_path(cmd->tmp_pool, path);
-  if (path_elts == NULL) {
-    int xerrno = errno;
+  if (dbacl_cache_head != NULL) {
+    dbacl_cache_head->prev = ce;
+  }
 
-    pr_trace_msg(trace_channel, 4,
-      "error splitting path '%s': %s", path, strerror(xerrno));
+  dbacl_cache_head = ce;
 
-    errno = xerrno;
-    return -1;
+  if (dbacl_cache_tail == NULL) {
+    dbacl_cache_tail = ce;
   }
+}
 
-  if (pr_trace_get_level(trace_channel) >= 9) {
-    register unsigned int i;
-    char **elts;
+static int dbacl_cache_alloc(void) {
+  int max_ents;
 
-    pr_trace_msg(trace_channel, 9,
-      "split path '%s' into the following list:", path);
+  dbacl_cache_pool = make_sub_pool(session.pool);
+  pr_pool_tag(dbacl_cache_pool, MOD_DBACL_VERSION " cache pool");
 
-    elts = path_elts->elts;
-    for (i = 0; i < path_elts->nelts; i++) {
-      pr_trace_msg(trace_channel, 9,
-        "path component #%u: '%s'", i+1, elts[i]);
-    }
+  dbacl_cache_tab = pr_table_alloc(dbacl_cache_pool, 0);
+
+  max_ents = (int) dbacl_cache_max_entries;
+  if (pr_table_ctl(dbacl_cache_tab, PR_TABLE_CTL_SET_MAX_ENTS,
+      &max_ents) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error setting cache table max entries to %d: %s", max_ents,
+      strerror(errno));
   }
 
-  res = dbacl_get_row(cmd->tmp_pool, acl_col, path_elts);
-  if (res < 0) {
-    int xerrno = errno;
+  dbacl_cache_head = dbacl_cache_tail = NULL;
+  dbacl_cache_count = 0;
+  dbacl_cache_size = 0;
+  dbacl_cache_alloc_size = 0;
 
-    pr_trace_msg(trace_channel, 4,
-      "error getting database row for ACL column '%s', path '%s': %s",
-      acl_col, path, strerror(xerrno));
+  return 0;
+}
 
-    errno = xerrno;
+static int dbacl_cache_add(const char *key, size_t keysz,
+    const struct dbacl_row *row, time_t expires) {
+  struct dbacl_cache_entry *ce;
+  char *dup_key;
+
+  dup_key = palloc(dbacl_cache_pool, keysz);
+  memcpy(dup_key, key, keysz);
+
+  ce = pcalloc(dbacl_cache_pool, sizeof(struct dbacl_cache_entry));
+  ce->key = dup_key;
+  ce->keysz = keysz;
+  memcpy(&(ce->row), row, sizeof(struct dbacl_row));
+  ce->expires = expires;
+
+  if (pr_table_kadd(dbacl_cache_tab, ce->key, ce->keysz, ce,
+      sizeof(struct dbacl_cache_entry)) < 0) {
     return -1;
   }
 
-  if (res == FALSE) {
-    char *cmd_name;
+  dbacl_cache_link(ce);
+  dbacl_cache_count++;
+  dbacl_cache_size += dbacl_cache_entry_size(ce);
+  dbacl_cache_alloc_size += dbacl_cache_entry_size(ce);
 
-    cmd_name = cmd->argv[0];
-    if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0) {
-      cmd_name = pstrcat(cmd->tmp_pool, cmd->argv[0], " ", cmd->argv[1], NULL);
-    }
+  return 0;
+}
 
-    pr_trace_msg(trace_channel, 9,
-      "command '%s' on path '%s' explicitly denied by table '%s', column '%s'",
-      cmd_name, path, dbacl_table, acl_col);
+static void dbacl_cache_remove(struct dbacl_cache_entry *ce) {
+  (void) pr_table_kremove(dbacl_cache_tab, ce->key, ce->keysz, NULL);
+  dbacl_cache_unlink(ce);
 
-    *policy = DBACL_POLICY_DENY;
+  dbacl_cache_count--;
+  dbacl_cache_size -= dbacl_cache_entry_size(ce);
+}
 
-  } else {
-    char *cmd_name;
+static void dbacl_cache_compact(void) {
+  pool *old_pool;
+  struct dbacl_cache_entry *ce, *old_tail;
 
-    cmd_name = cmd->argv[0];
-    if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0) {
-      cmd_name = pstrcat(cmd->tmp_pool, cmd->argv[0], " ", cmd->argv[1], NULL);
-    }
+  pr_trace_msg(trace_channel, 15,
+    "compacting cache (%u entries, %lu live bytes, %lu allocated bytes)",
+    dbacl_cache_count, (unsigned long) dbacl_cache_size,
+    (unsigned long) dbacl_cache_alloc_size);
 
-    pr_trace_msg(trace_channel, 9,
-      "command '%s' on path '%s' explicitly allowed by table '%s', column '%s'",
-      cmd_name, path, dbacl_table, acl_col);
+  old_pool = dbacl_cache_pool;
+  old_tail = dbacl_cache_tail;
 
-    *policy = DBACL_POLICY_ALLOW;
+  dbacl_cache_alloc();
+
+  /* Re-add the entries from least to most recently used, so that the LRU
+   * order is preserved.
+   */
+  for (ce = old_tail; ce != NULL; ce = ce->prev) {
+    (void) dbacl_cache_add(ce->key, ce->keysz, &(ce->row), ce->expires);
   }
 
-  return res;
+  destroy_pool(old_pool);
 }
 
-static int dbacl_get_acl(cmd_rec *cmd, const char *proto, int *policy) {
-  const char *acl_col;
-  char *path;
-  int res;
+static int dbacl_cache_get(const char *path, size_t pathlen,
+    struct dbacl_row *row) {
+  const struct dbacl_cache_entry *found;
+  struct dbacl_cache_entry *ce;
 
-  acl_col = dbacl_get_column(cmd, proto);
-  if (acl_col == NULL) {
-    pr_trace_msg(trace_channel, 4,
-      "no mapping of command '%s' to ACL column", cmd->argv[0]);
+  if (dbacl_cache_tab == NULL) {
+    errno = EPERM;
     return -1;
   }
 
-  /* We need to handle SFTP LINK/SYMLINK requests differently, since
-   * they a) involve two paths and b) have no direct FTP equivalents.
-   *
-   * XXX What about mod_site_misc's SITE SYMLINK?
-   */
+  found = pr_table_kget(dbacl_cache_tab, path, pathlen, NULL);
+  if (found == NULL) {
+    errno = ENOENT;
+    return -1;
+  }
 
-  if (strncasecmp(proto, "ftp", 4) == 0 ||
-      strncasecmp(proto, "ftps", 5) == 0 ) {
-    path = dbacl_get_path(cmd, proto);
-    if (path == NULL) {
-      pr_trace_msg(trace_channel, 4,
-        "unable to get full path for command '%s'", cmd->argv[0]);
-      return -1;
-    }
+  ce = (struct dbacl_cache_entry *) found;
 
-    res = dbacl_get_path_acl(cmd, acl_col, path, policy);
-    if (res < 0) {
-      return res;
-    }
+  /* With a generation query, entries are also discarded (earlier) when the
+   * generation changes; the TTL still limits how long they are used, should
+   * the generation query fail or the generation not be changed.
+   */
+  if (ce->expires <= time(NULL)) {
+    pr_trace_msg(trace_channel, 17, "cached row for path '%.*s' expired",
+      (int) pathlen, path);
+    dbacl_cache_remove(ce);
 
-    return 0;
+    errno = ENOENT;
+    return -1;
+  }
 
-  } else if (strncasecmp(proto, "sftp", 5) == 0) {
-    if (pr_cmd_strcmp(cmd, "SYMLINK") != 0 &&
-        pr_cmd_strcmp(cmd, "LINK") != 0) {
+  /* Move the entry to the front of the LRU list. */
+  if (ce != dbacl_cache_head) {
+    dbacl_cache_unlink(ce);
+    dbacl_cache_link(ce);
+  }
 
-      path = dbacl_get_path(cmd, proto);
-      if (path == NULL) {
-        pr_trace_msg(trace_channel, 4,
-          "unable to get full path for command '%s'", cmd->argv[0]);
-        return -1;
-      }
+  memcpy(row, &(ce->row), sizeof(struct dbacl_row));
+  return 0;
+}
 
-      res = dbacl_get_path_acl(cmd, acl_col, path, policy);
-      if (res < 0) {
-        return res;
-      }
+static void dbacl_cache_put(const char *path, size_t pathlen,
+    const struct dbacl_row *row) {
+  const struct dbacl_cache_entry *found;
+  size_t keysz, entsz;
 
-      return 0;
+  if (dbacl_cache_tab == NULL) {
+    return;
+  }
 
-    } else {
-      char *arg, *ptr;
+  keysz = pathlen;
+  entsz = sizeof(struct dbacl_cache_entry) + keysz;
 
-      arg = pstrdup(cmd->tmp_pool, cmd->arg);
-      ptr = strchr(arg, '\t');
-      if (ptr == NULL) {
-        /* Malformed SFTP SYMLINK/LINK cmd_rec. */
-        pr_trace_msg(trace_channel, 1,
-          "malformed SFTP %s request, ignoring", cmd->argv[0]);
-        errno = EINVAL;
-        return -1;
-      }
+  if (entsz > dbacl_cache_max_size) {
+    pr_trace_msg(trace_channel, 15,
+      "not caching row for path '%.*s': entry size (%lu) exceeds cache size "
+      "limit", (int) pathlen, path, (unsigned long) entsz);
+    return;
+  }
 
-      *ptr = '\0';
+  found = pr_table_kget(dbacl_cache_tab, path, keysz, NULL);
+  if (found != NULL) {
+    dbacl_cache_remove((struct dbacl_cache_entry *) found);
+  }
 
-      /* Check source path first. */
-      path = arg;
+  /* Evict least recently used entries until the new entry fits. */
+  while (dbacl_cache_tail != NULL &&
+         (dbacl_cache_count >= dbacl_cache_max_entries ||
+          dbacl_cache_size + entsz > dbacl_cache_max_size)) {
+    pr_signals_handle();
+    dbacl_cache_remove(dbacl_cache_tail);
+  }
 
-      /* XXX Need to absolutize this path */
+  if (dbacl_cache_alloc_size - dbacl_cache_size > dbacl_cache_max_size) {
+    dbacl_cache_compact();
+  }
 
-      res = dbacl_get_path_acl(cmd, acl_col, path, policy);
-      if (res < 0) {
-        return res;
-      }
+  if (dbacl_cache_add(path, keysz, row, time(NULL) + dbacl_cache_ttl) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error caching row for path '%.*s': %s", (int) pathlen, path,
+      strerror(errno));
+    return;
+  }
 
-      if (*policy == DBACL_POLICY_DENY) {
-        /* Source path is denied; reject the request. */
-        return 0;
-      }
+  pr_trace_msg(trace_channel, 17,
+    "cached %s for path '%.*s' (%u entries, %lu bytes)",
+    row->exists ? "row" : "lack of row", (int) pathlen, path, dbacl_cache_count,
+    (unsigned long) dbacl_cache_size);
+}
 
-      /* Check destination path next. */
-      path = ptr + 1;
+static void dbacl_cache_clear(void) {
+  if (dbacl_cache_pool == NULL) {
+    return;
+  }
 
-      /* XXX Need to absolutize this path */
+  pr_trace_msg(trace_channel, 15,
+    "clearing cache (%u entries, %lu bytes)", dbacl_cache_count,
+    (unsigned long) dbacl_cache_size);
 
-      res = dbacl_get_path_acl(cmd, acl_col, path, policy);
-      if (res < 0) {
-        return res;
-      }
+  destroy_pool(dbacl_cache_pool);
+  dbacl_cache_alloc();
+}
+
+/* Shared cache routines
+ */
+
+#define DBACL_SHM_FNV_BASIS		0xcbf29ce484222325ULL
+#define DBACL_SHM_FNV_PRIME		0x100000001b3ULL
+#define DBACL_SHM_ALT_BASIS		0x84222325cbf29ce4ULL
+#define DBACL_SHM_ALT_PRIME		0x9e3779b97f4a7c15ULL
+
+/* Two independent 64-bit FNV-1a style hashes, for a 128-bit key; false
+ * matches between different principals/paths are then vanishingly
+ * unlikely.
+ */
+static void dbacl_shm_hash(uint64_t *key, const char *data, size_t datasz) {
+  register size_t i;
+
+  for (i = 0; i < datasz; i++) {
+    key[0] ^= (unsigned char) data[i];
+    key[0] *= DBACL_SHM_FNV_PRIME;
+
+    key[1] ^= (unsigned char) data[i];
+    key[1] *= DBACL_SHM_ALT_PRIME;
+  }
+}
+
+static int dbacl_shm_create(unsigned int max_entries) {
+  void *ptr;
+  unsigned int nbuckets;
+  size_t shm_size;
+
+  nbuckets = (max_entries + DBACL_SHM_BUCKET_SIZE - 1) / DBACL_SHM_BUCKET_SIZE;
+  shm_size = (size_t) nbuckets * DBACL_SHM_BUCKET_SIZE *
+    sizeof(struct dbacl_shm_slot);
+
+#if defined(MAP_ANONYMOUS)
+  ptr = mmap(NULL, shm_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS,
+    -1, 0);
+#elif defined(MAP_ANON)
+  ptr = mmap(NULL, shm_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+#else
+  ptr = MAP_FAILED;
+  errno = ENOSYS;
+#endif /* MAP_ANONYMOUS */
+
+  if (ptr == MAP_FAILED) {
+    return -1;
+  }
+
+  /* Anonymous mappings are zero-filled, i.e. every slot starts out empty. */
+  dbacl_shm_slots = ptr;
+  dbacl_shm_nslots = nbuckets * DBACL_SHM_BUCKET_SIZE;
+  dbacl_shm_size = shm_size;
+
+  return 0;
+}
+
+static void dbacl_shm_destroy(void) {
+  if (dbacl_shm_slots != NULL) {
+    (void) munmap((void *) dbacl_shm_slots, dbacl_shm_size);
+  }
+
+  dbacl_shm_slots = NULL;
+  dbacl_shm_nslots = 0;
+  dbacl_shm_size = 0;
+}
+
+/* Returns the database (and database user) of the SQL connection used for
+ * our queries, from the SQLConnectInfo (or, for a named connection, the
+ * SQLNamedConnectInfo) of the session's server.
+ */
+static const char *dbacl_get_conn_info(pool *p) {
+  config_rec *c;
+
+  if (strcmp(dbacl_conn_name, "default") == 0) {
+    c = find_config(main_server->conf, CONF_PARAM, "SQLConnectInfo", FALSE);
+    if (c != NULL &&
+        c->argc >= 2) {
+      return pstrcat(p, c->argv[0] != NULL ? (char *) c->argv[0] : "", "\t",
+        c->argv[1] != NULL ? (char *) c->argv[1] : "", NULL);
+    }
+
+    return "";
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "SQLNamedConnectInfo",
+    FALSE);
+  while (c != NULL) {
+    pr_signals_handle();
+
+    if (c->argc >= 4 &&
+        c->argv[0] != NULL &&
+        strcmp(c->argv[0], dbacl_conn_name) == 0) {
+      return pstrcat(p, c->argv[2] != NULL ? (char *) c->argv[2] : "", "\t",
+        c->argv[3] != NULL ? (char *) c->argv[3] : "", NULL);
+    }
+
+    c = find_config_next(c, c->next, CONF_PARAM, "SQLNamedConnectInfo",
+      FALSE);
+  }
+
+  return "";
+}
+
+/* Returns the string identifying the rows which this session would query:
+ * the given server, database, table and columns, the generation, and the
+ * WHERE clause with its user/group variables resolved.  Clauses using any
+ * other variables cannot be resolved here, and so cannot use the shared
+ * cache.
+ */
+static char *dbacl_shm_get_principal(pool *p, const char *server) {
+  const char *clause, *ptr;
+  char *principal;
+
+  principal = pstrcat(p, server, "\t", dbacl_get_conn_info(p), "\t",
+    dbacl_conn_name, "\t", dbacl_table, "\t", dbacl_get_row_cols(p), "\t",
+    NULL);
+
+  /* Rows cached for earlier generations are then not seen. */
+  if (dbacl_generation != NULL) {
+    principal = pstrcat(p, principal, dbacl_generation, "\t", NULL);
+  }
+
+  clause = dbacl_where_clause;
+  if (clause == NULL) {
+    return principal;
+  }
+
+  for (ptr = strchr(clause, '%'); ptr != NULL; ptr = strchr(clause, '%')) {
+    const char *value;
+
+    switch (ptr[1]) {
+      case 'u':
+        value = session.user;
+        break;
+
+      case 'g':
+        value = session.group;
+        break;
+
+      default:
+        errno = EINVAL;
+        return NULL;
+    }
+
+    principal = pstrcat(p, principal, pstrndup(p, clause, ptr - clause),
+      value != NULL ? value : "", NULL);
+    clause = ptr + 2;
+  }
+
+  return pstrcat(p, principal, clause, NULL);
+}
+
+static int dbacl_shm_init(pool *p) {
+  char *principal, sid[32];
+
+  snprintf(sid, sizeof(sid), "%u", main_server->sid);
+  principal = dbacl_shm_get_principal(p, sid);
+  if (principal == NULL) {
+    return -1;
+  }
+
+  dbacl_shm_principal_key[0] = DBACL_SHM_FNV_BASIS;
+  dbacl_shm_principal_key[1] = DBACL_SHM_ALT_BASIS;
+
+  /* Include the terminating NUL, so that the principal and path cannot run
+   * together.
+   */
+  dbacl_shm_hash(dbacl_shm_principal_key, principal, strlen(principal) + 1);
+  return 0;
+}
+
+static struct dbacl_shm_slot *dbacl_shm_get_bucket(const char *path,
+    size_t pathlen, uint64_t *key) {
+  key[0] = dbacl_shm_principal_key[0];
+  key[1] = dbacl_shm_principal_key[1];
+  dbacl_shm_hash(key, path, pathlen);
+
+  return &(dbacl_shm_slots[(key[0] % (dbacl_shm_nslots / DBACL_SHM_BUCKET_SIZE)) *
+    DBACL_SHM_BUCKET_SIZE]);
+}
+
+static int dbacl_shm_get(const char *path, size_t pathlen,
+    struct dbacl_row *row) {
+  register unsigned int i;
+  struct dbacl_shm_slot *bucket;
+  uint64_t key[2];
+  time_t now;
+
+  if (dbacl_shm_slots == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  bucket = dbacl_shm_get_bucket(path, pathlen, key);
+  now = time(NULL);
+
+  for (i = 0; i < DBACL_SHM_BUCKET_SIZE; i++) {
+    struct dbacl_shm_slot *slot, copy;
+    uint32_t seqno;
+
+    slot = &(bucket[i]);
+
+    seqno = slot->seqno;
+    if (seqno & 1) {
+      /* Being written. */
+      continue;
+    }
+
+    __sync_synchronize();
+    memcpy(&copy, (void *) slot, sizeof(copy));
+    __sync_synchronize();
+
+    if (slot->seqno != seqno) {
+      /* Written while we were reading it. */
+      continue;
+    }
+
+    if (copy.key[0] != key[0] ||
+        copy.key[1] != key[1]) {
+      continue;
+    }
+
+    if (copy.expires <= (int64_t) now) {
+      break;
+    }
+
+    memcpy(row, &(copy.row), sizeof(struct dbacl_row));
+
+    pr_trace_msg(trace_channel, 9, "using shared cached %s for path '%.*s'",
+      row->exists ? "row" : "lack of row", (int) pathlen, path);
+    return 0;
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
+static void dbacl_shm_put(const char *path, size_t pathlen,
+    const struct dbacl_row *row) {
+  register unsigned int i;
+  struct dbacl_shm_slot *bucket, *slot = NULL;
+  uint64_t key[2];
+  uint32_t seqno;
+  time_t now;
+
+  if (dbacl_shm_slots == NULL) {
+    return;
+  }
+
+  bucket = dbacl_shm_get_bucket(path, pathlen, key);
+  now = time(NULL);
+
+  /* Reuse the slot for this key, else the first empty/expired slot, else
+   * the slot which expires soonest.  These unsynchronized reads are only
+   * hints; the slot is claimed below.
+   */
+  for (i = 0; i < DBACL_SHM_BUCKET_SIZE; i++) {
+    struct dbacl_shm_slot *s;
+
+    s = &(bucket[i]);
+
+    if (s->key[0] == key[0] &&
+        s->key[1] == key[1]) {
+      slot = s;
+      break;
+    }
+
+    if (slot == NULL ||
+        (slot->expires > (int64_t) now &&
+         s->expires < slot->expires)) {
+      slot = s;
+    }
+  }
+
+  seqno = slot->seqno;
+  if (seqno & 1) {
+    return;
+  }
+
+  /* If a writer dies mid-write, its slot is left unusable; that costs one
+   * slot, never a wrong answer.
+   */
+  if (!__sync_bool_compare_and_swap(&(slot->seqno), seqno, seqno + 1)) {
+    return;
+  }
+
+  slot->key[0] = key[0];
+  slot->key[1] = key[1];
+  slot->expires = (int64_t) (now + dbacl_shm_ttl);
+  memcpy(&(slot->row), row, sizeof(struct dbacl_row));
+
+  __sync_synchronize();
+  slot->seqno = seqno + 2;
+}
+
+/* Looks up the row for a path in the session's cache and then the shared
+ * cache, copying rows found in the shared cache into the session's cache.
+ */
+static int dbacl_cache_lookup(const char *path, size_t pathlen,
+    struct dbacl_row *row) {
+  if (dbacl_cache_engine &&
+      dbacl_cache_get(path, pathlen, row) == 0) {
+    return 0;
+  }
+
+  if (dbacl_shm_get(path, pathlen, row) == 0) {
+    if (dbacl_cache_engine) {
+      dbacl_cache_put(path, pathlen, row);
+    }
+
+    return 0;
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
+static void dbacl_cache_store(const char *path, size_t pathlen,
+    const struct dbacl_row *row) {
+  if (dbacl_cache_engine) {
+    dbacl_cache_put(path, pathlen, row);
+  }
+
+  dbacl_shm_put(path, pathlen, row);
+}
+
+/* Redis routines
+ */
+
+/* Computes the key prefix for the session's principal; it changes with the
+ * generation, so that rows stored for earlier generations are not seen.
+ */
+static int dbacl_redis_init(pool *p) {
+  char *principal, server[32];
+  char prefix[34];
+  uint64_t key[2];
+
+  /* Unlike the shared cache, Redis may be shared by several daemons, whose
+   * SIDs for the same server may differ; use its name and port instead.
+   */
+  snprintf(server, sizeof(server), "%u", main_server->ServerPort);
+  principal = dbacl_shm_get_principal(p,
+    pstrcat(p, main_server->ServerName, ":", server, NULL));
+  if (principal == NULL) {
+    return -1;
+  }
+
+  /* Redis holds the rows used for entire paths, after any DBACLPatterns rows
+   * are applied, so sessions using different patterns cannot share them.
+   */
+  if (dbacl_patterns_engine == TRUE) {
+    principal = pstrcat(p, principal, "\tpatterns\t",
+      dbacl_patterns_clause != NULL ? dbacl_patterns_clause : "", NULL);
+  }
+
+  key[0] = DBACL_SHM_FNV_BASIS;
+  key[1] = DBACL_SHM_ALT_BASIS;
+  dbacl_shm_hash(key, principal, strlen(principal));
+
+  snprintf(prefix, sizeof(prefix), "%016llx%016llx:",
+    (unsigned long long) key[0], (unsigned long long) key[1]);
+  dbacl_redis_prefix = pstrdup(session.pool, prefix);
+  return 0;
+}
+
+static int dbacl_redis_open(pool *p) {
+#ifdef PR_USE_REDIS
+  int xerrno;
+
+  dbacl_redis = pr_redis_conn_new(session.pool, &dbacl_module, 0);
+  if (dbacl_redis == NULL) {
+    return -1;
+  }
+
+  (void) pr_redis_conn_set_namespace(dbacl_redis, &dbacl_module,
+    DBACL_REDIS_NAMESPACE, strlen(DBACL_REDIS_NAMESPACE));
+
+  if (dbacl_redis_init(p) < 0) {
+    xerrno = errno;
+
+    (void) pr_redis_conn_destroy(dbacl_redis);
+    dbacl_redis = NULL;
+
+    errno = xerrno;
+    return -1;
+  }
+
+  return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif /* PR_USE_REDIS */
+}
+
+static void dbacl_redis_close(void) {
+#ifdef PR_USE_REDIS
+  if (dbacl_redis != NULL) {
+    (void) pr_redis_conn_destroy(dbacl_redis);
+    dbacl_redis = NULL;
+  }
+#endif /* PR_USE_REDIS */
+}
+
+static int dbacl_redis_is_open(void) {
+#ifdef PR_USE_REDIS
+  return dbacl_redis != NULL ? TRUE : FALSE;
+#else
+  return FALSE;
+#endif /* PR_USE_REDIS */
+}
+
+/* Rows are stored as text, one digit per ACL value in DBACL_ACL index
+ * order, or "-" for no row, so that servers built differently can share
+ * them.
+ */
+static int dbacl_redis_get(pool *p, const char *path, struct dbacl_row *row) {
+#ifdef PR_USE_REDIS
+  register unsigned int i;
+  char *key, *value;
+  size_t valuesz = 0;
+
+  if (dbacl_redis == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  key = pstrcat(p, dbacl_redis_prefix, path, NULL);
+
+  value = pr_redis_get(p, dbacl_redis, &dbacl_module, key, &valuesz);
+  if (value == NULL) {
+    int xerrno = errno;
+
+    if (xerrno == ENOENT) {
+      dbacl_stats_redis_misses++;
+
+    } else {
+      pr_trace_msg(trace_channel, 3,
+        "error getting Redis row for path '%s': %s", path, strerror(xerrno));
+      dbacl_stats_redis_errors++;
+    }
+
+    errno = xerrno;
+    return -1;
+  }
+
+  memset(row, 0, sizeof(struct dbacl_row));
+
+  if (valuesz == 1 &&
+      value[0] == '-') {
+    dbacl_stats_redis_hits++;
+    return 0;
+  }
+
+  if (valuesz != DBACL_ACL_COUNT) {
+    pr_trace_msg(trace_channel, 3,
+      "ignoring malformed Redis row for path '%s'", path);
+    dbacl_stats_redis_errors++;
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < DBACL_ACL_COUNT; i++) {
+    if (value[i] < '0' + DBACL_VALUE_NONE ||
+        value[i] > '0' + DBACL_VALUE_DENY) {
+      pr_trace_msg(trace_channel, 3,
+        "ignoring malformed Redis row for path '%s'", path);
+      dbacl_stats_redis_errors++;
+      errno = EINVAL;
+      return -1;
+    }
+
+    row->acls[i] = value[i] - '0';
+  }
+
+  row->exists = TRUE;
+  dbacl_stats_redis_hits++;
+  return 0;
+#else
+  errno = EPERM;
+  return -1;
+#endif /* PR_USE_REDIS */
+}
+
+static void dbacl_redis_put(pool *p, const char *path,
+    const struct dbacl_row *row) {
+#ifdef PR_USE_REDIS
+  register unsigned int i;
+  char *key, value[DBACL_ACL_COUNT];
+  size_t valuesz;
+
+  if (dbacl_redis == NULL) {
+    return;
+  }
+
+  if (row->exists) {
+    for (i = 0; i < DBACL_ACL_COUNT; i++) {
+      value[i] = '0' + row->acls[i];
+    }
+
+    valuesz = DBACL_ACL_COUNT;
+
+  } else {
+    value[0] = '-';
+    valuesz = 1;
+  }
+
+  key = pstrcat(p, dbacl_redis_prefix, path, NULL);
+
+  if (pr_redis_set(dbacl_redis, &dbacl_module, key, value, valuesz,
+      (time_t) dbacl_redis_ttl) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error storing Redis row for path '%s': %s", path, strerror(errno));
+    dbacl_stats_redis_errors++;
+  }
+#endif /* PR_USE_REDIS */
+}
+
+static const char *dbacl_get_acl_col(int acl) {
+  switch (acl) {
+    case DBACL_ACL_READ:
+      return dbacl_read_col;
+
+    case DBACL_ACL_WRITE:
+      return dbacl_write_col;
+
+    case DBACL_ACL_DELETE:
+      return dbacl_delete_col;
+
+    case DBACL_ACL_CREATE:
+      return dbacl_create_col;
+
+    case DBACL_ACL_MODIFY:
+      return dbacl_modify_col;
+
+    case DBACL_ACL_MOVE:
+      return dbacl_move_col;
+
+    case DBACL_ACL_VIEW:
+      return dbacl_view_col;
+
+    case DBACL_ACL_NAVIGATE:
+      return dbacl_navigate_col;
+  }
+
+  errno = ENOENT;
+  return NULL;
+}
+
+static unsigned char dbacl_parse_value(const char *str) {
+  int res;
+
+  res = dbacl_is_boolean(str);
+  if (res < 0) {
+    return DBACL_VALUE_NONE;
+  }
+
+  return res ? DBACL_VALUE_ALLOW : DBACL_VALUE_DENY;
+}
+
+/* Parses the ACL values of a row, as returned for dbacl_get_row_cols(),
+ * after its path value.
+ */
+static void dbacl_parse_row(char **values, unsigned char *acls) {
+  register unsigned int i;
+
+  if (dbacl_acls_col != NULL) {
+    unsigned long packed = 0;
+
+    /* mod_sql returns NULL values as "NULL", which parses as zero, i.e.
+     * no values.
+     */
+    if (values[0] != NULL) {
+      packed = strtoul(values[0], NULL, 10);
+    }
+
+    for (i = 0; i < DBACL_ACL_COUNT; i++) {
+      acls[i] = (packed >> (i * DBACL_PACKED_BITS)) & DBACL_PACKED_MASK;
+      if (acls[i] > DBACL_VALUE_DENY) {
+        acls[i] = DBACL_VALUE_NONE;
+      }
+    }
+
+    return;
+  }
+
+  for (i = 0; i < DBACL_ACL_COUNT; i++) {
+    acls[i] = dbacl_parse_value(values[i]);
+  }
+}
+
+/* Trie routines
+ */
+
+static struct dbacl_node *dbacl_node_create(pool *p, const char *name,
+    size_t namelen) {
+  struct dbacl_node *node;
+
+  node = pcalloc(p, sizeof(struct dbacl_node));
+  node->name = pstrndup(p, name, namelen);
+  node->namelen = namelen;
+
+  return node;
+}
+
+static int dbacl_node_cmp(const char *name, size_t namelen,
+    struct dbacl_node *node) {
+  int res;
+
+  res = memcmp(name, node->name,
+    namelen < node->namelen ? namelen : node->namelen);
+  if (res == 0) {
+    if (namelen < node->namelen) {
+      res = -1;
+
+    } else if (namelen > node->namelen) {
+      res = 1;
+    }
+  }
+
+  return res;
+}
+
+/* Finds the child with the given name.  If there is no such child, the
+ * index at which it would be inserted is provided.
+ */
+static struct dbacl_node *dbacl_node_get_child(struct dbacl_node *node,
+    const char *name, size_t namelen, unsigned int *idx) {
+  unsigned int lo = 0, hi = node->nchildren;
+
+  while (lo < hi) {
+    unsigned int mid;
+    int res;
+
+    mid = lo + ((hi - lo) / 2);
+    res = dbacl_node_cmp(name, namelen, node->children[mid]);
+    if (res == 0) {
+      if (idx != NULL) {
+        *idx = mid;
+      }
+
+      return node->children[mid];
+    }
+
+    if (res < 0) {
+      hi = mid;
+
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  if (idx != NULL) {
+    *idx = lo;
+  }
+
+  return NULL;
+}
+
+static struct dbacl_node *dbacl_node_add_child(pool *p,
+    struct dbacl_node *node, const char *name, size_t namelen) {
+  struct dbacl_node *child;
+  unsigned int idx;
+
+  child = dbacl_node_get_child(node, name, namelen, &idx);
+  if (child != NULL) {
+    return child;
+  }
+
+  if (node->nchildren == node->maxchildren) {
+    struct dbacl_node **children;
+    unsigned int maxchildren;
+
+    maxchildren = node->maxchildren ? node->maxchildren * 2 : 4;
+    children = palloc(p, maxchildren * sizeof(struct dbacl_node *));
+
+    if (node->nchildren > 0) {
+      memcpy(children, node->children,
+        node->nchildren * sizeof(struct dbacl_node *));
+    }
+
+    node->children = children;
+    node->maxchildren = maxchildren;
+  }
+
+  if (idx < node->nchildren) {
+    memmove(&(node->children[idx + 1]), &(node->children[idx]),
+      (node->nchildren - idx) * sizeof(struct dbacl_node *));
+  }
+
+  child = dbacl_node_create(p, name, namelen);
+  child->depth = node->depth + 1;
+  node->children[idx] = child;
+  node->nchildren++;
+
+  return child;
+}
+
+/* Adds the row for the given absolute path, creating the nodes for its
+ * components as needed.  Empty components (e.g. from "//" or a trailing "/")
+ * are skipped.
+ */
+static struct dbacl_node *dbacl_trie_add(pool *p, struct dbacl_node *root,
+    const char *path, const unsigned char *acls) {
+  struct dbacl_node *node = root;
+  const char *ptr;
+
+  ptr = path;
+  while (*ptr != '\0') {
+    const char *end;
+
+    if (*ptr == '/') {
+      ptr++;
+      continue;
+    }
+
+    end = strchr(ptr, '/');
+    if (end == NULL) {
+      end = ptr + strlen(ptr);
+    }
+
+    node = dbacl_node_add_child(p, node, ptr, end - ptr);
+    ptr = end;
+  }
+
+  /* As with the LIMIT 1 lookup query, only the first row for a given path
+   * is used.
+   */
+  if (node->row.exists == FALSE) {
+    node->row.exists = TRUE;
+    memcpy(node->row.acls, acls, sizeof(node->row.acls));
+  }
+
+  return node;
+}
+
+/* Returns the deepest node, on the way to the given path, which has a row;
+ * NULL is returned if no such node exists.  As with the lookup query, the
+ * row for "/" is only used for "/" itself, since it is not one of the
+ * components of any other path (see dbacl_split_path()).
+ */
+static struct dbacl_node *dbacl_trie_match(struct dbacl_node *root,
+    const char *path) {
+  struct dbacl_node *node = root, *match = NULL;
+  const char *ptr;
+
+  if (strcmp(path, "/") == 0) {
+    return root->row.exists ? root : NULL;
+  }
+
+  ptr = path;
+  while (*ptr != '\0') {
+    const char *end;
+
+    if (*ptr == '/') {
+      ptr++;
+      continue;
+    }
+
+    end = strchr(ptr, '/');
+    if (end == NULL) {
+      end = ptr + strlen(ptr);
+    }
+
+    node = dbacl_node_get_child(node, ptr, end - ptr, NULL);
+    if (node == NULL) {
+      break;
+    }
+
+    if (node->row.exists) {
+      match = node;
+    }
+
+    ptr = end;
+  }
+
+  return match;
+}
+
+/* Preload routines
+ */
+
+static void dbacl_preload_clear(struct dbacl_preload *pl) {
+  if (pl->pool != NULL) {
+    destroy_pool(pl->pool);
+  }
+
+  memset(pl, 0, sizeof(struct dbacl_preload));
+}
+
+/* Returns the number of levels by which the given path is below the root
+ * path, or -1 if the path is not at or under the root.
+ */
+static int dbacl_preload_get_level(struct dbacl_preload *pl,
+    const char *path) {
+  const char *ptr;
+  int level = 0;
+
+  if (pl->rootlen > 1) {
+    if (strncmp(path, pl->root, pl->rootlen) != 0 ||
+        (path[pl->rootlen] != '\0' &&
+         path[pl->rootlen] != '/')) {
+      return -1;
+    }
+
+    ptr = path + pl->rootlen;
+
+  } else {
+    /* Every path is under "/"; its leading slash separates the first
+     * level.
+     */
+    if (path[1] == '\0') {
+      return 0;
+    }
+
+    ptr = path;
+  }
+
+  for (; *ptr != '\0'; ptr++) {
+    if (*ptr == '/') {
+      level++;
+    }
+  }
+
+  return level;
+}
+
+static int dbacl_preload_rows(pool *p, struct dbacl_preload *pl,
+    const char *root, unsigned int levels) {
+  register unsigned int i;
+  struct dbacl_path *dp;
+  struct dbacl_buf buf;
+  char *query, **values;
+  array_header *sql_data;
+  size_t rootlen;
+  unsigned int nrows = 0;
+
+  dp = dbacl_split_path(p, root);
+  if (dp == NULL) {
+    return -1;
+  }
+
+  if (dbacl_escape_path(p, dp) < 0) {
+    return -1;
+  }
+
+  /* Select the rows for the root and its ancestors, and for everything
+   * under the root (down to the given number of levels).  The paths under
+   * the root are selected as a range, i.e. those after "root/" and before
+   * "root0" ('0' being the character after '/'), rather than using
+   * "LIKE 'root/%'", so that the database can use an index on the path
+   * column; nor can any LIKE wildcard characters in the root then match
+   * additional rows.
+   */
+  dbacl_buf_init(p, &buf, 256);
+  dbacl_buf_appendstr(&buf, dbacl_rows_query_prefix);
+  dbacl_buf_appendstr(&buf, "(");
+  dbacl_buf_appendstr(&buf, dbacl_path_col);
+  dbacl_buf_appendstr(&buf, " IN (");
+
+  for (i = 0; i < dp->ncomponents; i++) {
+    if (i > 0) {
+      dbacl_buf_append(&buf, ", ", 2);
+    }
+
+    dbacl_buf_append(&buf, "'", 1);
+    dbacl_buf_append(&buf, dp->escaped_path, dp->escaped_lens[i]);
+    dbacl_buf_append(&buf, "'", 1);
+  }
+
+  rootlen = dp->lens[dp->ncomponents-1];
+
+  dbacl_buf_appendstr(&buf, ") OR (");
+  dbacl_buf_appendstr(&buf, dbacl_path_col);
+  dbacl_buf_appendstr(&buf, " >= '");
+
+  if (rootlen > 1) {
+    dbacl_buf_append(&buf, dp->escaped_path,
+      dp->escaped_lens[dp->ncomponents-1]);
+  }
+
+  dbacl_buf_appendstr(&buf, "/' AND ");
+  dbacl_buf_appendstr(&buf, dbacl_path_col);
+  dbacl_buf_appendstr(&buf, " < '");
+
+  if (rootlen > 1) {
+    dbacl_buf_append(&buf, dp->escaped_path,
+      dp->escaped_lens[dp->ncomponents-1]);
+  }
+
+  dbacl_buf_appendstr(&buf, "0'");
+
+  /* Limit the rows to the given levels by counting their '/' characters,
+   * rather than using "NOT LIKE 'root/%/%'", as mod_sql would take the '%'
+   * for a variable (and any '_' in the root would be a wildcard).  The
+   * levels of the rows returned are checked again below.
+   */
+  if (levels > 0) {
+    char count[32];
+    unsigned int nslashes = levels;
+
+    if (rootlen > 1) {
+      for (i = 0; i < rootlen; i++) {
+        if (dp->path[i] == '/') {
+          nslashes++;
+        }
+      }
+    }
+
+    snprintf(count, sizeof(count), "%u", nslashes);
+
+    dbacl_buf_appendstr(&buf, " AND LENGTH(");
+    dbacl_buf_appendstr(&buf, dbacl_path_col);
+    dbacl_buf_appendstr(&buf, ") - LENGTH(REPLACE(");
+    dbacl_buf_appendstr(&buf, dbacl_path_col);
+    dbacl_buf_appendstr(&buf, ", '/', '')) <= ");
+    dbacl_buf_appendstr(&buf, count);
+  }
+
+  dbacl_buf_appendstr(&buf, "))");
+  query = buf.data;
+
+  pr_trace_msg(trace_channel, 7, "constructed preload query '%s'", query);
+
+  sql_data = dbacl_sql_lookup(p, query);
+  if (sql_data == NULL) {
+    return -1;
+  }
+
+  if (sql_data->nelts % dbacl_row_ncols != 0) {
+    pr_trace_msg(trace_channel, 5,
+      "preload query '%s' returned incorrect number of values (%d)", query,
+      sql_data->nelts);
+    errno = EINVAL;
+    return -1;
+  }
+
+  dbacl_preload_clear(pl);
+
+  pl->pool = make_sub_pool(session.pool);
+  pr_pool_tag(pl->pool, MOD_DBACL_VERSION " preload pool");
+
+  pl->trie = dbacl_node_create(pl->pool, "/", 1);
+  pl->root = pstrndup(pl->pool, root, rootlen);
+  pl->rootlen = rootlen;
+  pl->levels = levels;
+  pl->loaded = time(NULL);
+
+  values = sql_data->elts;
+  for (i = 0; i < sql_data->nelts; i += dbacl_row_ncols) {
+    const char *path;
+    unsigned char acls[DBACL_ACL_COUNT];
+
+    pr_signals_handle();
+
+    path = values[i];
+    if (path == NULL ||
+        *path != '/') {
+      continue;
+    }
+
+    if (levels > 0 &&
+        dbacl_preload_get_level(pl, path) > (int) levels) {
+      continue;
+    }
+
+    dbacl_parse_row(values + i + 1, acls);
+    dbacl_trie_add(pl->pool, pl->trie, path, acls);
+    nrows++;
+  }
+
+  pr_trace_msg(trace_channel, 8, "preloaded %u %s for '%s'", nrows,
+    nrows != 1 ? "rows" : "row", root);
+  return 0;
+}
+
+/* Finds the row for the longest matching component of the given path in
+ * the trie, providing the depth of that component, if wanted.
+ */
+static int dbacl_preload_get(struct dbacl_preload *pl, const char *path,
+    struct dbacl_row *row, unsigned int *depth) {
+  struct dbacl_node *node;
+  int level;
+
+  if (pl->trie == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  /* Only paths at or under the preload root (and no deeper than the loaded
+   * levels) can be resolved from the trie; the rows for any other paths
+   * were not loaded.
+   */
+  level = dbacl_preload_get_level(pl, path);
+  if (level < 0 ||
+      (pl->levels > 0 &&
+       level > (int) pl->levels)) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  node = dbacl_trie_match(pl->trie, path);
+  if (node == NULL) {
+    memset(row, 0, sizeof(struct dbacl_row));
+
+  } else {
+    memcpy(row, &node->row, sizeof(struct dbacl_row));
+  }
+
+  if (depth != NULL) {
+    *depth = node != NULL ? node->depth : 0;
+  }
+
+  return 0;
+}
+
+/* Pattern routines
+ */
+
+static int dbacl_is_pattern(const char *path) {
+  return strpbrk(path, "*?") != NULL ? TRUE : FALSE;
+}
+
+static void dbacl_patterns_clear(struct dbacl_patterns *pats) {
+  if (pats->pool != NULL) {
+    destroy_pool(pats->pool);
+  }
+
+  memset(pats, 0, sizeof(struct dbacl_patterns));
+}
+
+static struct dbacl_pattern_node *dbacl_pattern_node_create(pool *p,
+    const char *name, size_t namelen) {
+  struct dbacl_pattern_node *node;
+
+  node = pcalloc(p, sizeof(struct dbacl_pattern_node));
+  node->name = pstrndup(p, name, namelen);
+  node->glob = dbacl_is_pattern(node->name);
+
+  return node;
+}
+
+static void dbacl_patterns_init(struct dbacl_patterns *pats) {
+  memset(pats, 0, sizeof(struct dbacl_patterns));
+
+  pats->pool = make_sub_pool(session.pool);
+  pr_pool_tag(pats->pool, MOD_DBACL_VERSION " patterns pool");
+
+  pats->root = dbacl_pattern_node_create(pats->pool, "/", 1);
+  pats->names = dbacl_pattern_node_create(pats->pool, "", 0);
+}
+
+static struct dbacl_pattern_node *dbacl_pattern_node_add_child(pool *p,
+    struct dbacl_pattern_node *node, const char *name, size_t namelen) {
+  register unsigned int i;
+  struct dbacl_pattern_node *child;
+
+  /* Patterns are few, and their children fewer; a linear search will do. */
+  for (i = 0; i < node->nchildren; i++) {
+    child = node->children[i];
+
+    if (strlen(child->name) == namelen &&
+        strncmp(child->name, name, namelen) == 0) {
+      return child;
+    }
+  }
+
+  if (node->nchildren == node->maxchildren) {
+    struct dbacl_pattern_node **children;
+    unsigned int maxchildren;
+
+    maxchildren = node->maxchildren ? node->maxchildren * 2 : 4;
+    children = palloc(p, maxchildren * sizeof(struct dbacl_pattern_node *));
+
+    if (node->nchildren > 0) {
+      memcpy(children, node->children,
+        node->nchildren * sizeof(struct dbacl_pattern_node *));
+    }
+
+    node->children = children;
+    node->maxchildren = maxchildren;
+  }
+
+  child = dbacl_pattern_node_create(p, name, namelen);
+  node->children[node->nchildren++] = child;
+
+  return child;
+}
+
+/* Adds the row for the given pattern.  Patterns not starting with '/' may
+ * only match a single name.
+ */
+static int dbacl_patterns_add(struct dbacl_patterns *pats, const char *path,
+    const unsigned char *acls) {
+  struct dbacl_pattern_node *node;
+  const char *ptr;
+  unsigned int nliterals = 0;
+
+  if (*path == '/') {
+    node = pats->root;
+
+  } else {
+    if (strchr(path, '/') != NULL) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    node = pats->names;
+  }
+
+  ptr = path;
+  while (*ptr != '\0') {
+    const char *end;
+
+    if (*ptr == '/') {
+      ptr++;
+      continue;
+    }
+
+    end = strchr(ptr, '/');
+    if (end == NULL) {
+      end = ptr + strlen(ptr);
+    }
+
+    node = dbacl_pattern_node_add_child(pats->pool, node, ptr, end - ptr);
+    ptr = end;
+  }
+
+  if (node == pats->root ||
+      node == pats->names) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (ptr = path; *ptr != '\0'; ptr++) {
+    if (*ptr != '*' &&
+        *ptr != '?') {
+      nliterals++;
+    }
+  }
+
+  /* As with literal rows, only the first row for a given pattern is used. */
+  if (node->row.exists == FALSE) {
+    node->row.exists = TRUE;
+    memcpy(node->row.acls, acls, sizeof(node->row.acls));
+    node->nliterals = nliterals;
+    node->order = pats->npatterns++;
+  }
+
+  return 0;
+}
+
+/* Loads the pattern rows from the table, replacing the current patterns; if
+ * they cannot be loaded, the current patterns are kept.
+ */
+static int dbacl_patterns_load(pool *p) {
+  register unsigned int i;
+  struct dbacl_patterns pats;
+  array_header *sql_data;
+  char *query, **values;
+
+  if (dbacl_patterns_clause != NULL) {
+    query = pstrcat(p, dbacl_rows_query_prefix, "(", dbacl_patterns_clause,
+      ")", NULL);
+
+  } else {
+    /* Select the paths containing either wildcard, without using LIKE (and
+     * so '%', which mod_sql would take for a variable).
+     */
+    query = pstrcat(p, dbacl_rows_query_prefix, "(REPLACE(", dbacl_path_col,
+      ", '*', '') <> ", dbacl_path_col, " OR REPLACE(", dbacl_path_col,
+      ", '?', '') <> ", dbacl_path_col, ")", NULL);
+  }
+
+  pr_trace_msg(trace_channel, 7, "constructed patterns query '%s'", query);
+
+  sql_data = dbacl_sql_lookup(p, query);
+  if (sql_data == NULL) {
+    return -1;
+  }
+
+  if (sql_data->nelts % dbacl_row_ncols != 0) {
+    pr_trace_msg(trace_channel, 5,
+      "patterns query '%s' returned incorrect number of values (%d)", query,
+      sql_data->nelts);
+    errno = EINVAL;
+    return -1;
+  }
+
+  dbacl_patterns_init(&pats);
+
+  values = sql_data->elts;
+  for (i = 0; i < sql_data->nelts; i += dbacl_row_ncols) {
+    const char *path;
+    unsigned char acls[DBACL_ACL_COUNT];
+
+    pr_signals_handle();
+
+    path = values[i];
+    if (path == NULL ||
+        dbacl_is_pattern(path) == FALSE) {
+      continue;
+    }
+
+    dbacl_parse_row(values + i + 1, acls);
+    if (dbacl_patterns_add(&pats, path, acls) < 0) {
+      pr_trace_msg(trace_channel, 6,
+        "skipping pattern '%s': relative patterns cannot contain '/'", path);
+    }
+  }
+
+  dbacl_patterns_clear(&dbacl_patterns);
+  memcpy(&dbacl_patterns, &pats, sizeof(pats));
+
+  pr_trace_msg(trace_channel, 8, "loaded %u %s", pats.npatterns,
+    pats.npatterns != 1 ? "patterns" : "pattern");
+  return 0;
+}
+
+/* Returns TRUE if the first pattern row is preferred over the second, for
+ * the same component: patterns starting with '/' over name patterns, then
+ * the pattern with more non-wildcard characters, then the first loaded.
+ */
+static int dbacl_pattern_is_better(const struct dbacl_pattern_node *a,
+    int a_abs, const struct dbacl_pattern_node *b, int b_abs) {
+  if (b == NULL) {
+    return TRUE;
+  }
+
+  if (a_abs != b_abs) {
+    return a_abs;
+  }
+
+  if (a->nliterals != b->nliterals) {
+    return a->nliterals > b->nliterals;
+  }
+
+  return a->order < b->order;
+}
+
+/* Matches the patterns against each of the components of the given path,
+ * as split by dbacl_split_path(), returning the row of the best pattern
+ * matching each component (or NULL), or NULL if no pattern matches any
+ * component.  All of the patterns matching each component are followed at
+ * once, so each component is examined once.
+ */
+static const struct dbacl_row **dbacl_patterns_match(pool *p,
+    const struct dbacl_path *dp) {
+  register unsigned int i;
+  const struct dbacl_row **matches = NULL;
+  array_header *active, *next;
+  size_t start = 1;
+
+  if (dbacl_patterns.npatterns == 0) {
+    return NULL;
+  }
+
+  active = make_array(p, 4, sizeof(struct dbacl_pattern_node *));
+  next = make_array(p, 4, sizeof(struct dbacl_pattern_node *));
+
+  *((struct dbacl_pattern_node **) push_array(active)) = dbacl_patterns.root;
+
+  for (i = 0; i < dp->ncomponents; i++) {
+    register unsigned int j, k;
+    struct dbacl_pattern_node **nodes, *best = NULL;
+    array_header *tmp;
+    const char *name;
+    size_t namelen;
+    int best_abs = FALSE;
+
+    namelen = dp->lens[i] - start;
+    name = pstrndup(p, dp->path + start, namelen);
+    start = dp->lens[i] + 1;
+
+    if (namelen == 0) {
+      /* The root, which no pattern matches. */
+      continue;
+    }
+
+    next->nelts = 0;
+
+    nodes = active->elts;
+    for (j = 0; j < active->nelts; j++) {
+      for (k = 0; k < nodes[j]->nchildren; k++) {
+        struct dbacl_pattern_node *child;
+
+        child = nodes[j]->children[k];
+
+        if (child->glob ? pr_fnmatch(child->name, name, 0) != 0 :
+            strcmp(child->name, name) != 0) {
+          continue;
+        }
+
+        *((struct dbacl_pattern_node **) push_array(next)) = child;
+
+        if (child->row.exists &&
+            dbacl_pattern_is_better(child, TRUE, best, best_abs)) {
+          best = child;
+          best_abs = TRUE;
+        }
+      }
+    }
+
+    for (k = 0; k < dbacl_patterns.names->nchildren; k++) {
+      struct dbacl_pattern_node *child;
+
+      child = dbacl_patterns.names->children[k];
+
+      if (pr_fnmatch(child->name, name, 0) == 0 &&
+          dbacl_pattern_is_better(child, FALSE, best, best_abs)) {
+        best = child;
+        best_abs = FALSE;
+      }
+    }
+
+    if (best != NULL) {
+      if (matches == NULL) {
+        matches = pcalloc(p, dp->ncomponents * sizeof(struct dbacl_row *));
+      }
+
+      matches[i] = &(best->row);
+    }
+
+    tmp = active;
+    active = next;
+    next = tmp;
+  }
+
+  return matches;
+}
+
+/* Uses the row of the best pattern matching the deepest component of the
+ * given path, if that component is deeper than the given depth, i.e. that
+ * of the path's longest matching row (if any).
+ */
+static int dbacl_patterns_apply(pool *p, const char *path, unsigned int depth,
+    struct dbacl_row *row) {
+  const struct dbacl_row **matches;
+  struct dbacl_path *dp;
+  int i;
+
+  if (dbacl_patterns.npatterns == 0) {
+    return 0;
+  }
+
+  dp = dbacl_split_path(p, path);
+  if (dp == NULL) {
+    return -1;
+  }
+
+  matches = dbacl_patterns_match(p, dp);
+  if (matches == NULL) {
+    return 0;
+  }
+
+  /* The components of a path start with its first name, i.e. at depth 1.
+   * For the same component, a row for the path itself is preferred over that
+   * of a pattern.
+   */
+  for (i = dp->ncomponents - 1; i >= 0 && (unsigned int) i >= depth; i--) {
+    if (matches[i] != NULL) {
+      pr_trace_msg(trace_channel, 9,
+        "using pattern row for component '%.*s' of path '%s'",
+        (int) dp->lens[i], dp->path, path);
+      memcpy(row, matches[i], sizeof(struct dbacl_row));
+      break;
+    }
+  }
+
+  return 0;
+}
+
+/* Prefetch routines
+ */
+
+static int dbacl_is_prefetch_cmd(cmd_rec *cmd) {
+  if (pr_cmd_cmp(cmd, PR_CMD_CWD_ID) == 0 ||
+      pr_cmd_cmp(cmd, PR_CMD_XCWD_ID) == 0 ||
+      pr_cmd_cmp(cmd, PR_CMD_LIST_ID) == 0 ||
+      pr_cmd_cmp(cmd, PR_CMD_NLST_ID) == 0 ||
+      pr_cmd_cmp(cmd, PR_CMD_MLSD_ID) == 0 ||
+      pr_cmd_strcmp(cmd, "OPENDIR") == 0) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Loads the rows for the given directory and its entries, unless they are
+ * already loaded, and recently enough.
+ */
+static void dbacl_prefetch(pool *p, const char *path) {
+  int level;
+
+  if (dbacl_prefetched.trie != NULL &&
+      strcmp(dbacl_prefetched.root, path) == 0 &&
+      time(NULL) - dbacl_prefetched.loaded < (time_t) dbacl_cache_ttl) {
+    return;
+  }
+
+  /* The entire subtree may already be preloaded. */
+  if (dbacl_preloaded.trie != NULL) {
+    level = dbacl_preload_get_level(&dbacl_preloaded, path);
+    if (level >= 0 &&
+        dbacl_preloaded.levels == 0) {
+      return;
+    }
+  }
+
+  if (dbacl_preload_rows(p, &dbacl_prefetched, path,
+      dbacl_prefetch_levels) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error prefetching rows for '%s': %s", path, strerror(errno));
+  }
+}
+
+/* Handle routines
+ */
+
+/* Returns TRUE if the command is an SFTP request which opens a file handle,
+ * as mod_sftp dispatches the RETR, STOR and APPE commands for OPEN requests.
+ */
+static int dbacl_is_handle_open_cmd(cmd_rec *cmd) {
+  if (dbacl_proto_id != DBACL_PROTO_SFTP) {
+    return FALSE;
+  }
+
+  if (pr_cmd_cmp(cmd, PR_CMD_RETR_ID) == 0 ||
+      pr_cmd_cmp(cmd, PR_CMD_STOR_ID) == 0 ||
+      pr_cmd_cmp(cmd, PR_CMD_APPE_ID) == 0) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Returns TRUE if the command is an SFTP request made using an open file
+ * handle.
+ */
+static int dbacl_is_handle_cmd(cmd_rec *cmd) {
+  if (dbacl_proto_id != DBACL_PROTO_SFTP) {
+    return FALSE;
+  }
+
+  if (pr_cmd_strcmp(cmd, "FSETSTAT") == 0) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+static struct dbacl_handle *dbacl_handle_get(const char *path) {
+  if (dbacl_handle_tab == NULL) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  return (struct dbacl_handle *) pr_table_kget(dbacl_handle_tab, path,
+    strlen(path) + 1, NULL);
+}
+
+static int dbacl_handle_open(const char *path, const struct dbacl_row *row) {
+  struct dbacl_handle *dh;
+  pool *sub_pool;
+
+  dh = dbacl_handle_get(path);
+  if (dh != NULL) {
+    /* Use the newly looked-up row for all of the handles on this path. */
+    memcpy(&(dh->row), row, sizeof(struct dbacl_row));
+    dh->refcount++;
+    return 0;
+  }
+
+  if (dbacl_handle_tab == NULL) {
+    int max_ents = DBACL_HANDLE_MAX_ENTRIES;
+
+    dbacl_handle_pool = make_sub_pool(session.pool);
+    pr_pool_tag(dbacl_handle_pool, MOD_DBACL_VERSION " handle pool");
+
+    dbacl_handle_tab = pr_table_alloc(dbacl_handle_pool, 0);
+    (void) pr_table_ctl(dbacl_handle_tab, PR_TABLE_CTL_SET_MAX_ENTS,
+      &max_ents);
+  }
+
+  sub_pool = make_sub_pool(dbacl_handle_pool);
+  pr_pool_tag(sub_pool, MOD_DBACL_VERSION " handle");
+
+  dh = pcalloc(sub_pool, sizeof(struct dbacl_handle));
+  dh->pool = sub_pool;
+  dh->path = pstrdup(sub_pool, path);
+  dh->pathsz = strlen(path) + 1;
+  dh->refcount = 1;
+  memcpy(&(dh->row), row, sizeof(struct dbacl_row));
+
+  if (pr_table_kadd(dbacl_handle_tab, dh->path, dh->pathsz, dh,
+      sizeof(struct dbacl_handle)) < 0) {
+    int xerrno = errno;
+
+    destroy_pool(sub_pool);
+
+    errno = xerrno;
+    return -1;
+  }
+
+  return 0;
+}
+
+static void dbacl_handle_close(const char *path) {
+  struct dbacl_handle *dh;
+
+  dh = dbacl_handle_get(path);
+  if (dh == NULL) {
+    return;
+  }
+
+  dh->refcount--;
+  if (dh->refcount > 0) {
+    return;
+  }
+
+  (void) pr_table_kremove(dbacl_handle_tab, dh->path, dh->pathsz, NULL);
+  destroy_pool(dh->pool);
+}
+
+static void dbacl_handle_clear(void) {
+  if (dbacl_handle_pool != NULL) {
+    destroy_pool(dbacl_handle_pool);
+    dbacl_handle_pool = NULL;
+    dbacl_handle_tab = NULL;
+  }
+}
+
+/* Bloom filter routines
+ */
+
+/* The two hashes are combined (h0 + i * h1) for each of the filter's hash
+ * functions.  The filter size is a power of two, so h1 is made odd, for the
+ * probes to reach every bit.
+ */
+static void dbacl_bloom_hash(const char *path, size_t pathlen, uint64_t *h) {
+  register size_t i;
+
+  h[0] = DBACL_SHM_FNV_BASIS;
+  h[1] = DBACL_SHM_ALT_BASIS;
+
+  for (i = 0; i < pathlen; i++) {
+    unsigned char c;
+
+    c = (unsigned char) path[i];
+
+    h[0] ^= c;
+    h[0] *= DBACL_SHM_FNV_PRIME;
+
+    h[1] ^= c;
+    h[1] *= DBACL_SHM_ALT_PRIME;
+  }
+
+  h[1] |= 1;
+}
+
+static void dbacl_bloom_add(unsigned char *bits, uint64_t nbits,
+    unsigned int nhashes, const char *path, size_t pathlen) {
+  register unsigned int i;
+  uint64_t h[2];
+
+  dbacl_bloom_hash(path, pathlen, h);
+
+  for (i = 0; i < nhashes; i++) {
+    uint64_t bit;
+
+    bit = (h[0] + (i * h[1])) & (nbits - 1);
+    bits[bit / 8] |= (1 << (bit % 8));
+  }
+}
+
+static int dbacl_bloom_test(const unsigned char *bits, uint64_t nbits,
+    unsigned int nhashes, const char *path, size_t pathlen) {
+  register unsigned int i;
+  uint64_t h[2];
+
+  dbacl_bloom_hash(path, pathlen, h);
+
+  for (i = 0; i < nhashes; i++) {
+    uint64_t bit;
+
+    bit = (h[0] + (i * h[1])) & (nbits - 1);
+    if (!(bits[bit / 8] & (1 << (bit % 8)))) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Checks the shared filter, unless it is being built, or was built for
+ * other rows than this session's; any path may then have a row.
+ */
+static int dbacl_bloom_shm_has(const char *path, size_t pathlen) {
+  struct dbacl_bloom_shm *bs;
+  uint64_t seqno;
+  int res = TRUE;
+
+  bs = dbacl_bloom_shm;
+
+  seqno = bs->seqno;
+  if (seqno & 1) {
+    return TRUE;
+  }
+
+  __sync_synchronize();
+
+  if (bs->key[0] == dbacl_bloom_key[0] &&
+      bs->key[1] == dbacl_bloom_key[1] &&
+      bs->nbits > 0) {
+    res = dbacl_bloom_test((const unsigned char *) (bs + 1), bs->nbits,
+      bs->nhashes, path, pathlen);
+  }
+
+  __sync_synchronize();
+
+  if (bs->seqno != seqno) {
+    return TRUE;
+  }
+
+  return res;
+}
+
+/* Returns FALSE only if the given path definitely has no row.  Without a
+ * filter, any path may have a row.
+ */
+static int dbacl_bloom_has(const char *path, size_t pathlen) {
+  if (dbacl_bloom_shared == TRUE) {
+    return dbacl_bloom_shm_has(path, pathlen);
+  }
+
+  if (dbacl_bloom_bits == NULL) {
+    return TRUE;
+  }
+
+  return dbacl_bloom_test(dbacl_bloom_bits, dbacl_bloom_nbits,
+    dbacl_bloom_nhashes, path, pathlen);
+}
+
+static int dbacl_bloom_is_used(void) {
+  return dbacl_bloom_shared == TRUE || dbacl_bloom_bits != NULL;
+}
+
+static void dbacl_bloom_clear(void) {
+  if (dbacl_bloom_pool != NULL) {
+    destroy_pool(dbacl_bloom_pool);
+    dbacl_bloom_pool = NULL;
+  }
+
+  dbacl_bloom_bits = NULL;
+  dbacl_bloom_nbits = 0;
+  dbacl_bloom_npaths = 0;
+  dbacl_bloom_shared = FALSE;
+}
+
+/* Selects every path in the table. */
+static array_header *dbacl_bloom_get_paths(pool *p) {
+  char *query;
+
+  query = pstrcat(p, "SELECT ", dbacl_path_col, " FROM ", dbacl_table, NULL);
+  if (dbacl_where_clause != NULL) {
+    query = pstrcat(p, query, " WHERE ", dbacl_where_clause, NULL);
+  }
+
+  pr_trace_msg(trace_channel, 7, "constructed Bloom filter query '%s'",
+    query);
+
+  return dbacl_sql_lookup(p, query);
+}
+
+/* Sizes the filter for the given number of paths: the number of bits is
+ * rounded up to a power of two, so that bits are selected using a mask, and
+ * the optimal number of hash functions is the number of bits per path times
+ * ln(2).
+ */
+static void dbacl_bloom_get_size(unsigned int npaths, uint64_t *nbits,
+    unsigned int *nhashes) {
+  *nbits = DBACL_BLOOM_MIN_BITS;
+  while (*nbits < (uint64_t) npaths * dbacl_bloom_bits_per_path) {
+    *nbits <<= 1;
+  }
+
+  *nhashes = ((dbacl_bloom_bits_per_path * 693) + 500) / 1000;
+  if (*nhashes < 1) {
+    *nhashes = 1;
+
+  } else if (*nhashes > 16) {
+    *nhashes = 16;
+  }
+}
+
+static unsigned int dbacl_bloom_fill(unsigned char *bits, uint64_t nbits,
+    unsigned int nhashes, array_header *paths) {
+  register int i;
+  char **values;
+  unsigned int npaths = 0;
+
+  values = paths->elts;
+  for (i = 0; i < paths->nelts; i++) {
+    if (values[i] == NULL) {
+      continue;
+    }
+
+    dbacl_bloom_add(bits, nbits, nhashes, values[i], strlen(values[i]));
+    npaths++;
+  }
+
+  return npaths;
+}
+
+/* Builds this session's own filter from the given paths. */
+static void dbacl_bloom_build_session(array_header *paths) {
+  dbacl_bloom_clear();
+
+  dbacl_bloom_get_size(paths->nelts, &dbacl_bloom_nbits,
+    &dbacl_bloom_nhashes);
+
+  dbacl_bloom_pool = make_sub_pool(session.pool);
+  pr_pool_tag(dbacl_bloom_pool, MOD_DBACL_VERSION " Bloom filter pool");
+
+  dbacl_bloom_bits = pcalloc(dbacl_bloom_pool,
+    (size_t) (dbacl_bloom_nbits / 8));
+  dbacl_bloom_npaths = dbacl_bloom_fill(dbacl_bloom_bits, dbacl_bloom_nbits,
+    dbacl_bloom_nhashes, paths);
+
+  pr_trace_msg(trace_channel, 8,
+    "built Bloom filter of %u %s (%lu bits, %u hashes)", dbacl_bloom_npaths,
+    dbacl_bloom_npaths != 1 ? "paths" : "path",
+    (unsigned long) dbacl_bloom_nbits, dbacl_bloom_nhashes);
+}
+
+/* Identifies the rows selected for the filter: the server key covers the
+ * server, database, table and clause, and the key also the generation.
+ */
+static void dbacl_bloom_get_keys(pool *p, uint64_t *server_key,
+    uint64_t *key) {
+  char *principal, sid[32];
+
+  snprintf(sid, sizeof(sid), "%u", main_server->sid);
+
+  principal = pstrcat(p, sid, "\t", dbacl_get_conn_info(p), "\t",
+    dbacl_conn_name, "\t", dbacl_table, "\t", dbacl_path_col, "\t",
+    dbacl_where_clause != NULL ? dbacl_where_clause : "", NULL);
+
+  server_key[0] = DBACL_SHM_FNV_BASIS;
+  server_key[1] = DBACL_SHM_ALT_BASIS;
+  dbacl_shm_hash(server_key, principal, strlen(principal) + 1);
+
+  key[0] = server_key[0];
+  key[1] = server_key[1];
+
+  if (dbacl_generation != NULL) {
+    dbacl_shm_hash(key, dbacl_generation, strlen(dbacl_generation));
+  }
+}
+
+/* Uses the shared filter, building it if it is missing, too old, or was
+ * built for an older generation.  Returns -1, with the selected paths if
+ * any, if this session is to build its own filter instead.
+ */
+static int dbacl_bloom_build_shared(pool *p, array_header **paths) {
+  struct dbacl_bloom_shm *bs;
+  uint64_t seqno, next_seqno, server_key[2], key[2], nbits;
+  unsigned int nhashes;
+  time_t now;
+
+  bs = dbacl_bloom_shm;
+  now = time(NULL);
+
+  dbacl_bloom_get_keys(p, server_key, key);
+
+  seqno = bs->seqno;
+  if (seqno & 1) {
+    /* Another session is building the filter; use it once it is built,
+     * unless that session seems to have failed to finish.
+     */
+    if (bs->built + (time_t) dbacl_bloom_max_age > now) {
+      dbacl_bloom_clear();
+      dbacl_bloom_key[0] = key[0];
+      dbacl_bloom_key[1] = key[1];
+      dbacl_bloom_shared = TRUE;
+      return 0;
+    }
+
+  } else {
+    int current;
+
+    __sync_synchronize();
+    current = (bs->nbits > 0 &&
+      bs->built + (time_t) dbacl_bloom_max_age > now);
+
+    if (current &&
+        bs->key[0] == key[0] &&
+        bs->key[1] == key[1]) {
+      dbacl_bloom_clear();
+      dbacl_bloom_key[0] = key[0];
+      dbacl_bloom_key[1] = key[1];
+      dbacl_bloom_shared = TRUE;
+
+      pr_trace_msg(trace_channel, 8,
+        "using shared Bloom filter of %u %s (%lu bits, %u hashes)",
+        bs->npaths, bs->npaths != 1 ? "paths" : "path",
+        (unsigned long) bs->nbits, bs->nhashes);
+      return 0;
+    }
+
+    /* The current filter of another table is left to its sessions. */
+    if (current &&
+        (bs->server_key[0] != server_key[0] ||
+         bs->server_key[1] != server_key[1])) {
+      errno = EEXIST;
+      return -1;
+    }
+  }
+
+  /* Take the filter over, keeping the seqno odd, if it was being built. */
+  next_seqno = (seqno & 1) ? seqno + 2 : seqno + 1;
+
+  if (!__sync_bool_compare_and_swap(&(bs->seqno), seqno, next_seqno)) {
+    /* Another session has started building it. */
+    dbacl_bloom_clear();
+    dbacl_bloom_key[0] = key[0];
+    dbacl_bloom_key[1] = key[1];
+    dbacl_bloom_shared = TRUE;
+    return 0;
+  }
+
+  seqno = next_seqno;
+  bs->built = now;
+
+  *paths = dbacl_bloom_get_paths(p);
+  if (*paths == NULL) {
+    int xerrno = errno;
+
+    bs->nbits = 0;
+    __sync_synchronize();
+    bs->seqno = seqno + 1;
+
+    errno = xerrno;
+    return -1;
+  }
+
+  dbacl_bloom_get_size((*paths)->nelts, &nbits, &nhashes);
+  if (nbits > DBACL_BLOOM_SHM_MAX_BITS) {
+    bs->nbits = 0;
+    __sync_synchronize();
+    bs->seqno = seqno + 1;
+
+    pr_trace_msg(trace_channel, 5,
+      "Bloom filter of %d paths too large for shared filter",
+      (*paths)->nelts);
+    errno = EFBIG;
+    return -1;
+  }
+
+  memset((unsigned char *) (bs + 1), 0, (size_t) (nbits / 8));
+  bs->npaths = dbacl_bloom_fill((unsigned char *) (bs + 1), nbits, nhashes,
+    *paths);
+  bs->nbits = nbits;
+  bs->nhashes = nhashes;
+  bs->server_key[0] = server_key[0];
+  bs->server_key[1] = server_key[1];
+  bs->key[0] = key[0];
+  bs->key[1] = key[1];
+
+  __sync_synchronize();
+  bs->seqno = seqno + 1;
+
+  dbacl_bloom_clear();
+  dbacl_bloom_key[0] = key[0];
+  dbacl_bloom_key[1] = key[1];
+  dbacl_bloom_shared = TRUE;
+
+  pr_trace_msg(trace_channel, 8,
+    "built shared Bloom filter of %u %s (%lu bits, %u hashes)", bs->npaths,
+    bs->npaths != 1 ? "paths" : "path", (unsigned long) nbits, nhashes);
+  return 0;
+}
+
+/* (Re)builds the filter, or starts using the shared one. */
+static int dbacl_bloom_build(pool *p) {
+  array_header *paths = NULL;
+
+  /* The rows of clauses with per-user variables differ between sessions. */
+  if (dbacl_bloom_shm != NULL &&
+      (dbacl_where_clause == NULL ||
+       strchr(dbacl_where_clause, '%') == NULL)) {
+    if (dbacl_bloom_build_shared(p, &paths) == 0) {
+      return 0;
+    }
+
+    pr_trace_msg(trace_channel, 9,
+      "not using shared Bloom filter: %s", strerror(errno));
+  }
+
+  if (paths == NULL) {
+    paths = dbacl_bloom_get_paths(p);
+    if (paths == NULL) {
+      return -1;
+    }
+  }
+
+  dbacl_bloom_build_session(paths);
+  return 0;
+}
+
+static int dbacl_bloom_shm_create(void) {
+  void *ptr;
+  size_t shm_size;
+
+  shm_size = sizeof(struct dbacl_bloom_shm) +
+    (size_t) (DBACL_BLOOM_SHM_MAX_BITS / 8);
+
+  /* Only the pages of the filter's bits which are used are ever touched,
+   * and so allocated.
+   */
+#if defined(MAP_ANONYMOUS)
+  ptr = mmap(NULL, shm_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS,
+    -1, 0);
+#elif defined(MAP_ANON)
+  ptr = mmap(NULL, shm_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+#else
+  ptr = MAP_FAILED;
+  errno = ENOSYS;
+#endif /* MAP_ANONYMOUS */
+
+  if (ptr == MAP_FAILED) {
+    return -1;
+  }
+
+  dbacl_bloom_shm = ptr;
+  dbacl_bloom_shm_size = shm_size;
+  return 0;
+}
+
+static void dbacl_bloom_shm_destroy(void) {
+  if (dbacl_bloom_shm != NULL) {
+    (void) munmap((void *) dbacl_bloom_shm, dbacl_bloom_shm_size);
+  }
+
+  dbacl_bloom_shm = NULL;
+  dbacl_bloom_shm_size = 0;
+}
+
+/* Snapshot routines
+ */
+
+/* Maps the given snapshot file, replacing the currently mapped snapshot,
+ * provided that the file is a valid snapshot not older than the current one.
+ */
+static int dbacl_snapshot_map(int fd, struct stat *st) {
+  const struct dbacl_snapshot_hdr *hdr;
+  void *data;
+  size_t datasz;
+
+  datasz = (size_t) st->st_size;
+  if (datasz < sizeof(struct dbacl_snapshot_hdr)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  data = mmap(NULL, datasz, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    return -1;
+  }
+
+  hdr = data;
+  if (memcmp(hdr->magic, DBACL_SNAPSHOT_MAGIC, sizeof(hdr->magic)) != 0 ||
+      hdr->version != DBACL_SNAPSHOT_VERSION ||
+      hdr->nnodes == 0 ||
+      hdr->nodes_offset > datasz ||
+      hdr->nnodes > (datasz - hdr->nodes_offset) /
+        sizeof(struct dbacl_snapshot_node) ||
+      hdr->names_offset > datasz ||
+      hdr->names_size > datasz - hdr->names_offset) {
+    (void) munmap(data, datasz);
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (dbacl_snapshot_data != NULL &&
+      hdr->generation < dbacl_snapshot_generation) {
+    pr_trace_msg(trace_channel, 3,
+      "ignoring snapshot generation %lu, older than current generation %lu",
+      (unsigned long) hdr->generation,
+      (unsigned long) dbacl_snapshot_generation);
+    (void) munmap(data, datasz);
+    errno = ESTALE;
+    return -1;
+  }
+
+  if (dbacl_snapshot_data != NULL) {
+    (void) munmap(dbacl_snapshot_data, dbacl_snapshot_datasz);
+  }
+
+  dbacl_snapshot_data = data;
+  dbacl_snapshot_datasz = datasz;
+  dbacl_snapshot_dev = st->st_dev;
+  dbacl_snapshot_ino = st->st_ino;
+  dbacl_snapshot_generation = hdr->generation;
+
+  pr_trace_msg(trace_channel, 8,
+    "mapped snapshot generation %lu (%lu nodes, %lu bytes)",
+    (unsigned long) hdr->generation, (unsigned long) hdr->nnodes,
+    (unsigned long) datasz);
+  return 0;
+}
+
+static int dbacl_snapshot_load(void) {
+  int fd, res, xerrno;
+  struct stat st;
+
+  fd = openat(dbacl_snapshot_dirfd, dbacl_snapshot_name, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (fstat(fd, &st) < 0) {
+    xerrno = errno;
+
+    (void) close(fd);
+    errno = xerrno;
+    return -1;
+  }
+
+  /* The mapping remains valid once the file is closed. */
+  res = dbacl_snapshot_map(fd, &st);
+  xerrno = errno;
+
+  (void) close(fd);
+  errno = xerrno;
+  return res;
+}
+
+/* Opens the directory of the given file, providing the file's name within
+ * it, so that the file can be found (and replaced) after any chroot.
+ */
+static int dbacl_open_dir(pool *p, const char *path, const char **name) {
+  char *dir, *ptr;
+  int dirfd;
+
+  ptr = strrchr(path, '/');
+  if (ptr == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  dir = ptr == path ? "/" : pstrndup(p, path, ptr - path);
+
+  dirfd = open(dir, O_RDONLY);
+  if (dirfd < 0) {
+    return -1;
+  }
+
+  /* Make sure this fd does not leak to any child processes. */
+  (void) fcntl(dirfd, F_SETFD, FD_CLOEXEC);
+
+  *name = pstrdup(session.pool, ptr + 1);
+  return dirfd;
+}
+
+static int dbacl_snapshot_open(pool *p, const char *path) {
+  dbacl_snapshot_dirfd = dbacl_open_dir(p, path, &dbacl_snapshot_name);
+  if (dbacl_snapshot_dirfd < 0) {
+    return -1;
+  }
+
+  dbacl_snapshot_checked = time(NULL);
+  return dbacl_snapshot_load();
+}
+
+/* Snapshots are replaced by renaming a new file into place, so a different
+ * inode means a new snapshot.
+ */
+static void dbacl_snapshot_check(void) {
+  struct stat st;
+  time_t now;
+
+  now = time(NULL);
+  if (now - dbacl_snapshot_checked < DBACL_SNAPSHOT_CHECK_INTERVAL) {
+    return;
+  }
+
+  dbacl_snapshot_checked = now;
+
+  if (fstatat(dbacl_snapshot_dirfd, dbacl_snapshot_name, &st, 0) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error checking snapshot '%s': %s", dbacl_snapshot_name,
+      strerror(errno));
+    return;
+  }
+
+  if (st.st_dev == dbacl_snapshot_dev &&
+      st.st_ino == dbacl_snapshot_ino) {
+    return;
+  }
+
+  if (dbacl_snapshot_load() < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error loading snapshot '%s': %s", dbacl_snapshot_name, strerror(errno));
+  }
+}
+
+static const struct dbacl_snapshot_node *dbacl_snapshot_get_child(
+    const struct dbacl_snapshot_node *node, const char *name, size_t namelen) {
+  const struct dbacl_snapshot_hdr *hdr;
+  const struct dbacl_snapshot_node *nodes;
+  const char *names;
+  uint32_t lo, hi;
+
+  hdr = dbacl_snapshot_data;
+  nodes = (const struct dbacl_snapshot_node *)
+    ((const char *) dbacl_snapshot_data + hdr->nodes_offset);
+  names = (const char *) dbacl_snapshot_data + hdr->names_offset;
+
+  if (node->first_child > hdr->nnodes ||
+      node->nchildren > hdr->nnodes - node->first_child) {
+    return NULL;
+  }
+
+  lo = node->first_child;
+  hi = node->first_child + node->nchildren;
+
+  while (lo < hi) {
+    const struct dbacl_snapshot_node *child;
+    uint32_t mid;
+    int res;
+
+    mid = lo + ((hi - lo) / 2);
+    child = &(nodes[mid]);
+
+    if (child->name_offset > hdr->names_size ||
+        child->name_len > hdr->names_size - child->name_offset) {
+      return NULL;
+    }
+
+    res = memcmp(name, names + child->name_offset,
+      namelen < child->name_len ? namelen : child->name_len);
+    if (res == 0) {
+      if (namelen < child->name_len) {
+        res = -1;
+
+      } else if (namelen > child->name_len) {
+        res = 1;
+      }
+    }
+
+    if (res == 0) {
+      return child;
+    }
+
+    if (res < 0) {
+      hi = mid;
+
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  return NULL;
+}
+
+/* Finds the row for the longest matching component of the given path in
+ * the snapshot.
+ */
+static int dbacl_snapshot_get(const char *path, struct dbacl_row *row) {
+  const struct dbacl_snapshot_hdr *hdr;
+  const struct dbacl_snapshot_node *node, *best = NULL;
+  const char *ptr;
+
+  if (dbacl_snapshot_dirfd < 0) {
+    errno = EPERM;
+    return -1;
+  }
+
+  dbacl_snapshot_check();
+
+  if (dbacl_snapshot_data == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  hdr = dbacl_snapshot_data;
+  node = (const struct dbacl_snapshot_node *)
+    ((const char *) dbacl_snapshot_data + hdr->nodes_offset);
+
+  /* As with the lookup query, the row for "/" (on the root node) is only
+   * used for "/" itself; see dbacl_trie_match().
+   */
+  if (strcmp(path, "/") == 0) {
+    memset(row, 0, sizeof(struct dbacl_row));
+
+    if (node->exists) {
+      row->exists = TRUE;
+      memcpy(row->acls, node->acls, sizeof(row->acls));
+    }
+
+    return 0;
+  }
+
+  ptr = path;
+  while (*ptr != '\0') {
+    const char *end;
+    size_t namelen;
+
+    while (*ptr == '/') {
+      ptr++;
+    }
+
+    if (*ptr == '\0') {
+      break;
+    }
+
+    end = strchr(ptr, '/');
+    namelen = end != NULL ? (size_t) (end - ptr) : strlen(ptr);
+
+    node = dbacl_snapshot_get_child(node, ptr, namelen);
+    if (node == NULL) {
+      break;
+    }
+
+    if (node->exists) {
+      best = node;
+    }
+
+    ptr += namelen;
+  }
+
+  memset(row, 0, sizeof(struct dbacl_row));
+
+  if (best != NULL) {
+    row->exists = TRUE;
+    memcpy(row->acls, best->acls, sizeof(row->acls));
+  }
+
+  return 0;
+}
+
+/* File backend routines
+ */
+
+/* Splits the given line into its tab-separated values, in place, returning
+ * the number of values.  Values beyond the maximum are ignored.
+ */
+static unsigned int dbacl_file_split_line(char *line, char **values,
+    unsigned int max_values) {
+  unsigned int nvalues = 0;
+  char *ptr;
+
+  ptr = line;
+  while (nvalues < max_values) {
+    char *end;
+
+    values[nvalues++] = ptr;
+
+    end = strchr(ptr, '\t');
+    if (end == NULL) {
+      break;
+    }
+
+    *end = '\0';
+    ptr = end + 1;
+  }
+
+  return nvalues;
+}
+
+/* Parses the given file contents into the trie of the given rows.  The
+ * first line is a header naming the columns, and each following line is
+ * a row, with its values separated by tabs, i.e. the table as exported by
+ * e.g. "sqlite3 -header -separator '<tab>'".  The path and ACL columns are
+ * found in the header using the DBACLSchema column names, in the same way
+ * as the database would find them; any other columns are ignored.  Empty
+ * values are NULL, as are "NULL" values.  Blank lines, and lines starting
+ * with '#', are skipped.  With DBACLPatterns, pattern rows are added to the
+ * given patterns, rather than the trie.
+ */
+static int dbacl_file_parse(struct dbacl_preload *pl,
+    struct dbacl_patterns *pats, char *data) {
+  register unsigned int i;
+  int cols[DBACL_ACL_COUNT + 1];
+  unsigned int lineno = 0, nrows = 0, nskipped = 0;
+  int have_header = FALSE;
+  char *ptr;
+
+  ptr = data;
+  while (*ptr != '\0') {
+    char *line, *end, *values[DBACL_FILE_MAX_COLS];
+    char *row_values[DBACL_ACL_COUNT + 1];
+    unsigned char acls[DBACL_ACL_COUNT];
+    unsigned int nvalues;
+    size_t linelen;
+
+    pr_signals_handle();
+
+    line = ptr;
+    lineno++;
+
+    end = strchr(ptr, '\n');
+    if (end != NULL) {
+      *end = '\0';
+      ptr = end + 1;
+
+    } else {
+      ptr += strlen(ptr);
+    }
+
+    linelen = strlen(line);
+    if (linelen > 0 &&
+        line[linelen-1] == '\r') {
+      line[--linelen] = '\0';
+    }
+
+    if (linelen == 0 ||
+        *line == '#') {
+      continue;
+    }
+
+    nvalues = dbacl_file_split_line(line, values, DBACL_FILE_MAX_COLS);
+
+    if (have_header == FALSE) {
+      for (i = 0; i < dbacl_row_ncols; i++) {
+        register unsigned int j;
+        const char *col_name;
+
+        if (i == 0) {
+          col_name = dbacl_path_col;
+
+        } else if (dbacl_acls_col != NULL) {
+          col_name = dbacl_acls_col;
+
+        } else {
+          col_name = dbacl_get_acl_col(i - 1);
+        }
+
+        cols[i] = -1;
+        for (j = 0; j < nvalues; j++) {
+          if (strcasecmp(values[j], col_name) == 0) {
+            cols[i] = (int) j;
+            break;
+          }
+        }
+
+        if (cols[i] < 0) {
+          pr_trace_msg(trace_channel, 3,
+            "DBACLBackend file '%s' has no '%s' column", dbacl_file_name,
+            col_name);
+          errno = EINVAL;
+          return -1;
+        }
+      }
+
+      have_header = TRUE;
+      continue;
+    }
+
+    for (i = 0; i < dbacl_row_ncols; i++) {
+      char *value = "NULL";
+
+      if ((unsigned int) cols[i] < nvalues &&
+          *(values[cols[i]]) != '\0') {
+        value = values[cols[i]];
+      }
+
+      row_values[i] = value;
+    }
+
+    if (pats != NULL &&
+        dbacl_is_pattern(row_values[0]) == TRUE) {
+      dbacl_parse_row(row_values + 1, acls);
+      if (dbacl_patterns_add(pats, row_values[0], acls) < 0) {
+        pr_trace_msg(trace_channel, 6,
+          "skipping line %u of DBACLBackend file '%s': relative pattern '%s' "
+          "contains '/'", lineno, dbacl_file_name, row_values[0]);
+        nskipped++;
+      }
+
+      continue;
+    }
+
+    /* As with the database, a row only matches an absolute path. */
+    if (*(row_values[0]) != '/') {
+      pr_trace_msg(trace_channel, 6,
+        "skipping line %u of DBACLBackend file '%s': path '%s' not absolute",
+        lineno, dbacl_file_name, row_values[0]);
+      nskipped++;
+      continue;
+    }
+
+    dbacl_parse_row(row_values + 1, acls);
+    dbacl_trie_add(pl->pool, pl->trie, row_values[0], acls);
+    nrows++;
+  }
+
+  if (have_header == FALSE) {
+    pr_trace_msg(trace_channel, 3,
+      "DBACLBackend file '%s' has no header line", dbacl_file_name);
+    errno = EINVAL;
+    return -1;
+  }
+
+  pr_trace_msg(trace_channel, 8,
+    "loaded %u %s (%u skipped) from DBACLBackend file '%s'", nrows,
+    nrows != 1 ? "rows" : "row", nskipped, dbacl_file_name);
+  return 0;
+}
+
+/* Loads the rows from the file, replacing the currently loaded rows; if the
+ * file cannot be loaded, the current rows are kept.
+ */
+static int dbacl_file_load(void) {
+  struct dbacl_preload pl;
+  struct dbacl_patterns pats, *patsp = NULL;
+  struct stat st;
+  pool *tmp_pool;
+  char *data;
+  size_t datasz = 0;
+  int fd, xerrno;
+
+  fd = openat(dbacl_file_dirfd, dbacl_file_name, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (fstat(fd, &st) < 0) {
+    xerrno = errno;
+
+    (void) close(fd);
+    errno = xerrno;
+    return -1;
+  }
+
+  if (!S_ISREG(st.st_mode)) {
+    (void) close(fd);
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(&pl, 0, sizeof(pl));
+  pl.pool = make_sub_pool(session.pool);
+  pr_pool_tag(pl.pool, MOD_DBACL_VERSION " file pool");
+
+  /* Only the trie is kept; the file contents are discarded once parsed. */
+  tmp_pool = make_sub_pool(pl.pool);
+  data = palloc(tmp_pool, (size_t) st.st_size + 1);
+
+  while (datasz < (size_t) st.st_size) {
+    ssize_t len;
+
+    len = read(fd, data + datasz, (size_t) st.st_size - datasz);
+    if (len < 0) {
+      if (errno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      xerrno = errno;
+
+      (void) close(fd);
+      destroy_pool(pl.pool);
+      errno = xerrno;
+      return -1;
+    }
+
+    if (len == 0) {
+      break;
+    }
+
+    datasz += len;
+  }
+
+  (void) close(fd);
+  data[datasz] = '\0';
+
+  pl.trie = dbacl_node_create(pl.pool, "/", 1);
+  pl.root = pstrdup(pl.pool, "/");
+  pl.rootlen = 1;
+  pl.levels = 0;
+  pl.loaded = time(NULL);
+
+  if (dbacl_patterns_engine == TRUE) {
+    dbacl_patterns_init(&pats);
+    patsp = &pats;
+  }
+
+  if (dbacl_file_parse(&pl, patsp, data) < 0) {
+    xerrno = errno;
+
+    if (patsp != NULL) {
+      dbacl_patterns_clear(patsp);
+    }
+
+    destroy_pool(pl.pool);
+    errno = xerrno;
+    return -1;
+  }
+
+  destroy_pool(tmp_pool);
+
+  dbacl_preload_clear(&dbacl_file_rows);
+  memcpy(&dbacl_file_rows, &pl, sizeof(pl));
+
+  if (patsp != NULL) {
+    dbacl_patterns_clear(&dbacl_patterns);
+    memcpy(&dbacl_patterns, patsp, sizeof(pats));
+  }
+
+  dbacl_file_mtime = st.st_mtime;
+  dbacl_file_ino = st.st_ino;
+  dbacl_file_size = st.st_size;
+
+  return 0;
+}
+
+static int dbacl_file_open(pool *p, const char *path) {
+  dbacl_file_dirfd = dbacl_open_dir(p, path, &dbacl_file_name);
+  if (dbacl_file_dirfd < 0) {
+    return -1;
+  }
+
+  dbacl_file_checked = time(NULL);
+  return 0;
+}
+
+/* The file may be edited in place, or replaced by renaming a new file into
+ * place; either way, its modification time (or inode, or size) changes.
+ */
+static void dbacl_file_check(void) {
+  struct stat st;
+  time_t now;
+
+  if (dbacl_file_dirfd < 0) {
+    return;
+  }
+
+  now = time(NULL);
+  if (now - dbacl_file_checked < DBACL_FILE_CHECK_INTERVAL) {
+    return;
+  }
+
+  dbacl_file_checked = now;
+
+  if (fstatat(dbacl_file_dirfd, dbacl_file_name, &st, 0) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error checking DBACLBackend file '%s': %s", dbacl_file_name,
+      strerror(errno));
+    return;
+  }
+
+  if (st.st_mtime == dbacl_file_mtime &&
+      st.st_ino == dbacl_file_ino &&
+      st.st_size == dbacl_file_size) {
+    return;
+  }
+
+  pr_trace_msg(trace_channel, 8,
+    "DBACLBackend file '%s' changed, loading rows", dbacl_file_name);
+
+  /* A file which cannot be loaded is not tried again until it changes. */
+  dbacl_file_mtime = st.st_mtime;
+  dbacl_file_ino = st.st_ino;
+  dbacl_file_size = st.st_size;
+
+  if (dbacl_file_load() < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error loading DBACLBackend file '%s', keeping current rows: %s",
+      dbacl_file_name, strerror(errno));
+    return;
+  }
+
+  /* Requests on already-open handles are checked against the new rows. */
+  dbacl_handle_clear();
+}
+
+/* Finds the row for the longest matching component of the given path in
+ * the rows loaded from the file.
+ */
+static int dbacl_file_get(const char *path, struct dbacl_row *row,
+    unsigned int *depth) {
+  struct dbacl_node *node;
+
+  dbacl_file_check();
+
+  if (dbacl_file_rows.trie == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  node = dbacl_trie_match(dbacl_file_rows.trie, path);
+
+  if (node == NULL) {
+    memset(row, 0, sizeof(struct dbacl_row));
+
+  } else {
+    memcpy(row, &node->row, sizeof(struct dbacl_row));
+  }
+
+  *depth = node != NULL ? node->depth : 0;
+  return 0;
+}
+
+/* Index check routines
+ */
+
+#define DBACL_SQL_BACKEND_UNKNOWN	0
+#define DBACL_SQL_BACKEND_SQLITE	1
+#define DBACL_SQL_BACKEND_MYSQL		2
+#define DBACL_SQL_BACKEND_POSTGRES	3
+
+/* Returns the mod_sql backend used for our queries: the configured
+ * SQLBackend, else the only backend module loaded.
+ */
+static int dbacl_get_sql_backend(void) {
+  config_rec *c;
+  int backend = DBACL_SQL_BACKEND_UNKNOWN, nbackends = 0;
+
+  c = find_config(main_server->conf, CONF_PARAM, "SQLBackend", FALSE);
+  if (c != NULL &&
+      c->argv[0] != NULL) {
+    const char *name;
+
+    name = c->argv[0];
+    if (strcasecmp(name, "sqlite3") == 0) {
+      return DBACL_SQL_BACKEND_SQLITE;
+    }
+
+    if (strcasecmp(name, "mysql") == 0) {
+      return DBACL_SQL_BACKEND_MYSQL;
+    }
+
+    if (strcasecmp(name, "postgres") == 0) {
+      return DBACL_SQL_BACKEND_POSTGRES;
+    }
+
+    return DBACL_SQL_BACKEND_UNKNOWN;
+  }
+
+  if (pr_module_get("mod_sql_sqlite.c") != NULL) {
+    backend = DBACL_SQL_BACKEND_SQLITE;
+    nbackends++;
+  }
+
+  if (pr_module_get("mod_sql_mysql.c") != NULL) {
+    backend = DBACL_SQL_BACKEND_MYSQL;
+    nbackends++;
+  }
+
+  if (pr_module_get("mod_sql_postgres.c") != NULL) {
+    backend = DBACL_SQL_BACKEND_POSTGRES;
+    nbackends++;
+  }
+
+  return nbackends == 1 ? backend : DBACL_SQL_BACKEND_UNKNOWN;
+}
+
+/* Returns TRUE if the text at the given position is the given table name,
+ * ending at the end of a word.
+ */
+static int dbacl_is_table_name(const char *str, const char *name) {
+  size_t namelen;
+
+  namelen = strlen(name);
+  if (strncmp(str, name, namelen) != 0) {
+    return FALSE;
+  }
+
+  return str[namelen] == '\0' ||
+         str[namelen] == ' ' ||
+         str[namelen] == '"' ||
+         str[namelen] == '`' ||
+         str[namelen] == '(';
+}
+
+/* Skips the JSON whitespace and name separator following a member name,
+ * returning the start of its value.
+ */
+static const char *dbacl_skip_json_sep(const char *str) {
+  while (*str == ' ' ||
+         *str == '\t' ||
+         *str == '\r' ||
+         *str == '\n' ||
+         *str == ':') {
+    str++;
+  }
+
+  return str;
+}
+
+/* Returns TRUE if the given line of the query plan shows a scan of the
+ * table:
+ *
+ *  SQLite (EXPLAIN QUERY PLAN):
+ *    SCAN ftpacl, SCAN TABLE ftpacl, or an automatic index built on it
+ *
+ *  MySQL (EXPLAIN FORMAT=JSON):
+ *    an access_type of ALL, or index (a scan of the whole index)
+ *
+ *  PostgreSQL (EXPLAIN):
+ *    Seq Scan on ftpacl
+ */
+static int dbacl_is_scan_plan(int backend, const char *plan,
+    const char *table) {
+  const char *ptr;
+
+  switch (backend) {
+    case DBACL_SQL_BACKEND_SQLITE:
+      if (strncmp(plan, "SCAN ", 5) == 0) {
+        ptr = plan + 5;
+        if (strncmp(ptr, "TABLE ", 6) == 0) {
+          ptr += 6;
+        }
+
+        return dbacl_is_table_name(ptr, table);
+      }
+
+      if (strncmp(plan, "SEARCH ", 7) == 0) {
+        ptr = plan + 7;
+        if (strncmp(ptr, "TABLE ", 6) == 0) {
+          ptr += 6;
+        }
+
+        return dbacl_is_table_name(ptr, table) &&
+          strstr(ptr, " AUTOMATIC ") != NULL;
+      }
+
+      return FALSE;
+
+    case DBACL_SQL_BACKEND_MYSQL:
+      ptr = plan;
+      while ((ptr = strstr(ptr, "\"table_name\"")) != NULL) {
+        ptr = dbacl_skip_json_sep(ptr + 12);
+        if (*ptr != '"' ||
+            !dbacl_is_table_name(ptr + 1, table)) {
+          continue;
+        }
+
+        ptr = strstr(ptr, "\"access_type\"");
+        if (ptr == NULL) {
+          break;
+        }
+
+        ptr = dbacl_skip_json_sep(ptr + 13);
+        if (strncmp(ptr, "\"ALL\"", 5) == 0 ||
+            strncmp(ptr, "\"index\"", 7) == 0) {
+          return TRUE;
+        }
+      }
+
+      return FALSE;
+
+    case DBACL_SQL_BACKEND_POSTGRES:
+      ptr = strstr(plan, "Seq Scan on ");
+      if (ptr == NULL) {
+        return FALSE;
+      }
+
+      return dbacl_is_table_name(ptr + 12, table);
+
+    default:
+      break;
+  }
+
+  return FALSE;
+}
+
+/* Creates the recommended index: on the path column, followed by any
+ * columns given to DBACLCheckIndexes (e.g. those used in DBACLWhereClause).
+ */
+static int dbacl_create_index(pool *p, const char *table) {
+  char *index_name, *ptr, *query;
+
+  index_name = pstrcat(p, table, "_", dbacl_path_col, "_idx", NULL);
+  for (ptr = index_name; *ptr; ptr++) {
+    if (!isalnum((int) *ptr)) {
+      *ptr = '_';
+    }
+  }
+
+  query = pstrcat(p, "CREATE INDEX ", index_name, " ON ", dbacl_table, " (",
+    dbacl_path_col, dbacl_check_indexes_cols != NULL ? ", " : "",
+    dbacl_check_indexes_cols, ")", NULL);
+
+  pr_trace_msg(trace_channel, 7, "constructed index query '%s'", query);
+
+  if (dbacl_sql_lookup(p, query) == NULL) {
+    pr_log_pri(PR_LOG_WARNING, MOD_DBACL_VERSION
+      ": error creating index using '%s', check SQLLogFile for details",
+      query);
+    return -1;
+  }
+
+  pr_log_pri(PR_LOG_NOTICE, MOD_DBACL_VERSION
+    ": created index using '%s'", query);
+  return 0;
+}
+
+/* Runs the given lookup query through the SQL backend's EXPLAIN, and warns
+ * if its plan scans the ACL table, i.e. if every lookup would read the
+ * entire table.  Returns TRUE if the table is scanned, FALSE if not, and -1
+ * if the plan could not be checked.
+ */
+static int dbacl_check_indexes(pool *p, const char *query) {
+  register unsigned int i;
+  int backend, scanned = FALSE;
+  array_header *sql_data;
+  char *explain, **values;
+  const char *table;
+
+  backend = dbacl_get_sql_backend();
+  switch (backend) {
+    case DBACL_SQL_BACKEND_SQLITE:
+      explain = pstrcat(p, "EXPLAIN QUERY PLAN ", query, NULL);
+      break;
+
+    case DBACL_SQL_BACKEND_MYSQL:
+      explain = pstrcat(p, "EXPLAIN FORMAT=JSON ", query, NULL);
+      break;
+
+    case DBACL_SQL_BACKEND_POSTGRES:
+      explain = pstrcat(p, "EXPLAIN ", query, NULL);
+      break;
+
+    default:
+      pr_trace_msg(trace_channel, 3, "%s",
+        "unable to determine SQLBackend, not checking query plan");
+      errno = ENOSYS;
+      return -1;
+  }
+
+  sql_data = dbacl_sql_lookup(p, explain);
+  if (sql_data == NULL) {
+    pr_trace_msg(trace_channel, 3,
+      "error explaining query '%s', not checking query plan", query);
+    return -1;
+  }
+
+  /* The plans name the table without any schema (or database) name. */
+  table = strrchr(dbacl_table, '.');
+  table = table != NULL ? table + 1 : dbacl_table;
+
+  values = sql_data->elts;
+  for (i = 0; i < sql_data->nelts; i++) {
+    if (values[i] != NULL &&
+        dbacl_is_scan_plan(backend, values[i], table)) {
+      scanned = TRUE;
+      break;
+    }
+  }
+
+  if (!scanned) {
+    pr_trace_msg(trace_channel, 9,
+      "query plan for '%s' uses an index on table '%s'", query, dbacl_table);
+    return FALSE;
+  }
+
+  pr_log_pri(PR_LOG_WARNING, MOD_DBACL_VERSION
+    ": WARNING: ACL lookup queries scan the entire '%s' table; create an "
+    "index on its '%s' column (and on any DBACLWhereClause columns)",
+    dbacl_table, dbacl_path_col);
+
+  pr_trace_msg(trace_channel, 1, "query plan for '%s':", query);
+  for (i = 0; i < sql_data->nelts; i++) {
+    if (values[i] != NULL) {
+      pr_trace_msg(trace_channel, 1, "  %s", values[i]);
+    }
+  }
+
+  if (dbacl_check_indexes_mode == DBACL_CHECK_INDEXES_CREATE) {
+    (void) dbacl_create_index(p, table);
+  }
+
+  return TRUE;
+}
+
+/* Builds the query selecting the rows for the given (escaped) path
+ * components, using the configured DBACLQueryStrategy, e.g.:
+ *
+ *  inlist:
+ *    SELECT path_col, read_col, ..., navigate_col FROM dbacl_table
+ *      WHERE path_col IN ('/home', '/home/user')
+ *
+ *  unionall:
+ *    SELECT ... FROM dbacl_table WHERE path_col = '/home'
+ *      UNION ALL SELECT ... FROM dbacl_table WHERE path_col = '/home/user'
+ *
+ *  join:
+ *    SELECT ... FROM dbacl_table JOIN
+ *      (SELECT '/home' AS dbacl_path UNION ALL SELECT '/home/user') dbacl_paths
+ *      ON path_col = dbacl_path
+ *
+ *  cte:
+ *    WITH dbacl_paths (dbacl_path) AS
+ *      (SELECT '/home' UNION ALL SELECT '/home/user')
+ *      SELECT ... FROM dbacl_table JOIN dbacl_paths ON path_col = dbacl_path
+ *
+ * Any DBACLWhereClause is included in the WHERE clause of every SELECT from
+ * the table.  Whichever the strategy, all of the matching rows are
+ * returned, rather than just the longest match, so that the rows for every
+ * component of the path can be cached.
+ */
+static char *dbacl_get_rows_query(pool *p, struct dbacl_path_elt *elts,
+    unsigned int nelts, size_t pathsz) {
+  register unsigned int i;
+  struct dbacl_buf buf;
+  size_t prefixsz, querysz;
+
+  switch (dbacl_query_strategy) {
+    case DBACL_QUERY_STRATEGY_UNIONALL:
+      prefixsz = strlen(dbacl_rows_query_prefix) + strlen(dbacl_path_col);
+      querysz = pathsz + (nelts * (prefixsz + 16));
+
+      dbacl_buf_init(p, &buf, querysz);
+
+      for (i = 0; i < nelts; i++) {
+        if (i > 0) {
+          dbacl_buf_appendstr(&buf, " UNION ALL ");
+        }
+
+        dbacl_buf_appendstr(&buf, dbacl_rows_query_prefix);
+        dbacl_buf_appendstr(&buf, dbacl_path_col);
+        dbacl_buf_append(&buf, " = ", 3);
+        dbacl_buf_append_elt(&buf, &elts[i]);
+      }
+      break;
+
+    case DBACL_QUERY_STRATEGY_JOIN:
+    case DBACL_QUERY_STRATEGY_CTE:
+      querysz = strlen(dbacl_rows_query_join) +
+        strlen(dbacl_rows_query_join_suffix) + pathsz + (nelts * 20) + 64;
+
+      dbacl_buf_init(p, &buf, querysz);
+
+      if (dbacl_query_strategy == DBACL_QUERY_STRATEGY_CTE) {
+        dbacl_buf_appendstr(&buf, "WITH dbacl_paths (dbacl_path) AS (");
+
+      } else {
+        dbacl_buf_appendstr(&buf, dbacl_rows_query_join);
+        dbacl_buf_append(&buf, "(", 1);
+      }
+
+      for (i = 0; i < nelts; i++) {
+        dbacl_buf_appendstr(&buf, i > 0 ? " UNION ALL SELECT " : "SELECT ");
+        dbacl_buf_append_elt(&buf, &elts[i]);
+
+        if (i == 0 &&
+            dbacl_query_strategy == DBACL_QUERY_STRATEGY_JOIN) {
+          dbacl_buf_appendstr(&buf, " AS dbacl_path");
+        }
+      }
+
+      if (dbacl_query_strategy == DBACL_QUERY_STRATEGY_CTE) {
+        dbacl_buf_append(&buf, ") ", 2);
+        dbacl_buf_appendstr(&buf, dbacl_rows_query_join);
+        dbacl_buf_appendstr(&buf, "dbacl_paths");
+
+      } else {
+        dbacl_buf_appendstr(&buf, ") dbacl_paths");
+      }
+
+      dbacl_buf_appendstr(&buf, dbacl_rows_query_join_suffix);
+      break;
+
+    case DBACL_QUERY_STRATEGY_INLIST:
+    default:
+      querysz = strlen(dbacl_rows_query_prefix) + strlen(dbacl_path_col) +
+        pathsz + (nelts * 4) + 8;
+
+      /* The WHERE clause is already included in the query prefix. */
+      dbacl_buf_init(p, &buf, querysz);
+      dbacl_buf_appendstr(&buf, dbacl_rows_query_prefix);
+      dbacl_buf_appendstr(&buf, dbacl_path_col);
+      dbacl_buf_appendstr(&buf, " IN (");
+
+      for (i = 0; i < nelts; i++) {
+        if (i > 0) {
+          /* Only prepend the comma separator if we are not the first item
+           * in the list.
+           */
+          dbacl_buf_append(&buf, ", ", 2);
+        }
+
+        dbacl_buf_append_elt(&buf, &elts[i]);
+      }
+
+      dbacl_buf_append(&buf, ")", 1);
+      break;
+  }
+
+  return buf.data;
+}
+
+/* Selects the rows, if any, for each of the given paths.  The returned list
+ * holds the path and ACL column values (see dbacl_get_row_cols()) for each
+ * row found.
+ */
+static array_header *dbacl_get_rows(pool *p, struct dbacl_path_elt *elts,
+    unsigned int nelts) {
+  register unsigned int i;
+  char *query = NULL;
+  size_t pathsz;
+  array_header *sql_data = NULL;
+  uint64_t start_ns;
+
+  /* Default schema:
+   *
+   *  CREATE TABLE dbacl (
+   *    user VARCHAR NOT NULL,
+   *    group VARCHAR NOT NULL,
+   *    path VARCHAR NOT NULL,
+   *    create BOOLEAN,
+   *    modify BOOLEAN,
+   *    write BOOLEAN,
+   *    read BOOLEAN,
+   *    delete BOOLEAN,
+   *    move BOOLEAN,
+   *    view BOOLEAN,
+   *  );
+   */
+
+  /* Sanitize the path components in the list we'll be used, to avoid any
+   * SQL injection attacks.  Each path is escaped once, for all of its
+   * components.
+   */
+  pathsz = 0;
+
+  start_ns = dbacl_stats_now();
+
+  for (i = 0; i < nelts; i++) {
+    if (dbacl_escape_path(p, elts[i].path) < 0) {
+      dbacl_stats_add(DBACL_STATS_PHASE_ESCAPE, start_ns);
+      return NULL;
+    }
+
+    pathsz += elts[i].path->escaped_lens[elts[i].idx];
+  }
+
+  dbacl_stats_add(DBACL_STATS_PHASE_ESCAPE, start_ns);
+
+  start_ns = dbacl_stats_now();
+  query = dbacl_get_rows_query(p, elts, nelts, pathsz);
+
+  dbacl_stats_add(DBACL_STATS_PHASE_QUERY, start_ns);
+
+  pr_trace_msg(trace_channel, 7, "constructed query '%s'", query);
+
+  if (dbacl_check_indexes_mode != DBACL_CHECK_INDEXES_OFF &&
+      dbacl_indexes_checked == FALSE) {
+    uint64_t deadline_ns;
+
+    /* The check is made once per session, and its time is not charged to
+     * the lookup's DBACLTimeout.
+     */
+    dbacl_indexes_checked = TRUE;
+    deadline_ns = dbacl_sql_deadline_ns;
+    dbacl_sql_deadline_ns = 0;
+
+    start_ns = dbacl_stats_now();
+    (void) dbacl_check_indexes(p, query);
+
+    if (deadline_ns > 0) {
+      dbacl_sql_deadline_ns = deadline_ns + (dbacl_stats_now() - start_ns);
+    }
+  }
+
+  sql_data = dbacl_sql_lookup(p, query);
+  if (sql_data == NULL) {
+    return NULL;
+  }
+
+  if (sql_data->nelts % dbacl_row_ncols != 0) {
+    pr_trace_msg(trace_channel, 5,
+      "query '%s' returned incorrect number of values (%d)", query,
+      sql_data->nelts);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  pr_trace_msg(trace_channel, 8, "query '%s' returned %d %s", query,
+    sql_data->nelts / dbacl_row_ncols,
+    sql_data->nelts != dbacl_row_ncols ? "rows" : "row");
+  return sql_data;
+}
+
+static int dbacl_generation_get(pool *p, const char **generation) {
+  array_header *sql_data;
+  char **values;
+
+  pr_trace_msg(trace_channel, 7, "constructed generation query '%s'",
+    dbacl_generation_query);
+
+  sql_data = dbacl_sql_lookup(p, dbacl_generation_query);
+  if (sql_data == NULL) {
+    return -1;
+  }
+
+  if (sql_data->nelts == 0) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  values = sql_data->elts;
+  *generation = values[0] != NULL ? values[0] : "";
+
+  return 0;
+}
+
+/* Polls the generation, at most once per configured interval, discarding
+ * the cached and preloaded rows if it has changed.
+ */
+static void dbacl_generation_check(pool *p) {
+  const char *generation = NULL;
+  time_t now;
+
+  if (dbacl_generation_query == NULL) {
+    return;
+  }
+
+  now = time(NULL);
+  if (dbacl_generation != NULL &&
+      now - dbacl_generation_checked < dbacl_generation_interval) {
+    return;
+  }
+
+  dbacl_generation_checked = now;
+
+  if (dbacl_generation_get(p, &generation) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error getting generation, keeping cached rows: %s", strerror(errno));
+    return;
+  }
+
+  if (dbacl_generation != NULL &&
+      strcmp(generation, dbacl_generation) == 0) {
+    return;
+  }
+
+  if (dbacl_generation == NULL) {
+    pr_trace_msg(trace_channel, 9, "using generation '%s'", generation);
+    dbacl_generation = pstrdup(session.pool, generation);
+    return;
+  }
+
+  pr_trace_msg(trace_channel, 8,
+    "generation changed from '%s' to '%s', discarding cached rows",
+    dbacl_generation, generation);
+  dbacl_generation = pstrdup(session.pool, generation);
+
+  dbacl_cache_clear();
+
+  if (dbacl_preloaded.trie != NULL) {
+    char *root;
+
+    root = pstrdup(p, dbacl_preloaded.root);
+    if (dbacl_preload_rows(p, &dbacl_preloaded, root, 0) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "error preloading rows for '%s': %s", root, strerror(errno));
+
+      /* Rather than use stale rows, look up each path in the database. */
+      dbacl_preload_clear(&dbacl_preloaded);
+    }
+  }
+
+  /* The prefetched rows are simply loaded again when next needed. */
+  dbacl_preload_clear(&dbacl_prefetched);
+
+  if (dbacl_patterns_engine == TRUE) {
+    if (dbacl_patterns_load(p) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "error loading patterns, keeping current patterns: %s",
+        strerror(errno));
+    }
+  }
+
+  /* Requests on already-open handles are checked against the new rows. */
+  dbacl_handle_clear();
+
+  if (dbacl_bloom_is_used()) {
+    if (dbacl_bloom_build(p) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "error rebuilding Bloom filter: %s", strerror(errno));
+
+      /* A stale filter could hide new rows; query every path instead. */
+      dbacl_bloom_clear();
+    }
+  }
+
+  if (dbacl_shm_slots != NULL) {
+    (void) dbacl_shm_init(p);
+  }
+
+  if (dbacl_redis_is_open()) {
+    (void) dbacl_redis_init(p);
+  }
+}
+
+/* Whether a directory has rows for any of its entries is kept in the row
+ * table and the caches as the "row" of the directory's path with a trailing
+ * '/', which no component has; its exists field is one of these.  The
+ * directory is only queried the second time it is seen, so that looking up
+ * a single path in a directory costs no additional query.
+ */
+#define DBACL_DIR_ROWS_NONE		0
+#define DBACL_DIR_ROWS_SOME		1
+#define DBACL_DIR_ROWS_SEEN		2
+
+/* Returns TRUE if there are any rows for the entries of the directory
+ * containing the given component of a path, FALSE if there are none, or -1
+ * if that is not known.  The database is only queried if wanted.
+ */
+static int dbacl_dir_has_rows(pool *p, pr_table_t *row_tab,
+    struct dbacl_path *dp, int idx, int query) {
+  struct dbacl_row *dir_row;
+  struct dbacl_buf buf;
+  array_header *sql_data;
+  char *key, count[32];
+  size_t dirlen, escapedlen = 0;
+  unsigned int nslashes;
+
+  if (idx > 0) {
+    dirlen = dp->lens[idx-1];
+
+  } else if (dp->lens[0] > 1) {
+    dirlen = 1;
+
+  } else {
+    /* The root directory is not an entry of any directory. */
+    return -1;
+  }
+
+  key = palloc(p, dirlen + 1);
+  memcpy(key, dp->path, dirlen);
+  key[dirlen] = '/';
+
+  dir_row = (struct dbacl_row *) pr_table_kget(row_tab, key, dirlen + 1,
+    NULL);
+  if (dir_row == NULL) {
+    dir_row = pcalloc(p, sizeof(struct dbacl_row));
+
+    if (dbacl_cache_lookup(key, dirlen + 1, dir_row) < 0) {
+      if (query == FALSE) {
+        return -1;
+      }
+
+      dir_row->exists = DBACL_DIR_ROWS_SEEN;
+      dbacl_cache_store(key, dirlen + 1, dir_row);
+      (void) pr_table_kadd(row_tab, key, dirlen + 1, dir_row,
+        sizeof(struct dbacl_row));
+      return -1;
+    }
+
+    (void) pr_table_kadd(row_tab, key, dirlen + 1, dir_row,
+      sizeof(struct dbacl_row));
+  }
+
+  if (dir_row->exists != DBACL_DIR_ROWS_SEEN) {
+    return dir_row->exists == DBACL_DIR_ROWS_SOME ? TRUE : FALSE;
+  }
+
+  if (query == FALSE) {
+    return -1;
+  }
+
+  if (dbacl_escape_path(p, dp) < 0) {
+    return -1;
+  }
+
+  if (idx > 0) {
+    escapedlen = dp->escaped_lens[idx-1];
+  }
+
+  /* Select any one row for an entry of the directory, i.e. for the paths
+   * after "dir/" and before "dir0" (as for dbacl_preload_rows()) with no
+   * further '/'.  The '/' characters are counted using REPLACE, rather than
+   * matched using LIKE, as mod_sql would take the '%' for a variable.
+   */
+  nslashes = 1;
+  if (dirlen > 1) {
+    register size_t i;
+
+    for (i = 0; i < dirlen; i++) {
+      if (dp->path[i] == '/') {
+        nslashes++;
+      }
+    }
+  }
+
+  snprintf(count, sizeof(count), "%u", nslashes);
+
+  dbacl_buf_init(p, &buf, 256);
+  dbacl_buf_appendstr(&buf, dbacl_rows_query_prefix);
+  dbacl_buf_appendstr(&buf, "(");
+  dbacl_buf_appendstr(&buf, dbacl_path_col);
+  dbacl_buf_appendstr(&buf, " > '");
+  dbacl_buf_append(&buf, dp->escaped_path, escapedlen);
+  dbacl_buf_appendstr(&buf, "/' AND ");
+  dbacl_buf_appendstr(&buf, dbacl_path_col);
+  dbacl_buf_appendstr(&buf, " < '");
+  dbacl_buf_append(&buf, dp->escaped_path, escapedlen);
+  dbacl_buf_appendstr(&buf, "0' AND LENGTH(");
+  dbacl_buf_appendstr(&buf, dbacl_path_col);
+  dbacl_buf_appendstr(&buf, ") - LENGTH(REPLACE(");
+  dbacl_buf_appendstr(&buf, dbacl_path_col);
+  dbacl_buf_appendstr(&buf, ", '/', '')) = ");
+  dbacl_buf_appendstr(&buf, count);
+  dbacl_buf_appendstr(&buf, ") LIMIT 1");
+
+  pr_trace_msg(trace_channel, 7, "constructed directory query '%s'",
+    buf.data);
+
+  sql_data = dbacl_sql_lookup(p, buf.data);
+  if (sql_data == NULL) {
+    return -1;
+  }
+
+  dbacl_stats_dir_queries++;
+
+  dir_row->exists = sql_data->nelts > 0 ? DBACL_DIR_ROWS_SOME :
+    DBACL_DIR_ROWS_NONE;
+  dbacl_cache_store(key, dirlen + 1, dir_row);
+
+  pr_trace_msg(trace_channel, 9, "directory '%.*s' has %s for its entries",
+    (int) dirlen, dp->path,
+    dir_row->exists == DBACL_DIR_ROWS_SOME ? "rows" : "no rows");
+  return dir_row->exists == DBACL_DIR_ROWS_SOME ? TRUE : FALSE;
+}
+
+/* Finds the rows for the longest matching components of each of the given
+ * paths.  If a snapshot is mapped, all paths are resolved from it; failing
+ * that, with the file backend, all paths are resolved from its rows.  Paths
+ * under the preload or prefetch roots are resolved from their tries.  For the
+ * other paths, the components which are not in the Bloom filter, whose
+ * rows (or lack thereof) are cached, or whose directories have no rows for
+ * any of their entries, are not queried; nor are any of the components of
+ * the paths whose rows are found in Redis.  The remaining
+ * components of all of the paths are queried together, DBACL_QUERY_MAX_PATHS
+ * at a time, so that e.g. all of the entries of a directory need only one
+ * or a few queries.  Paths with no matching component have their rows marked
+ * as not existing.
+ */
+static int dbacl_resolve_paths(pool *p, char **paths, unsigned int npaths,
+    struct dbacl_row *rows) {
+  register unsigned int i;
+  struct dbacl_path **dps;
+  struct dbacl_path_elt *elts;
+  array_header *query_elts;
+  pr_table_t *row_tab;
+  int max_ents, *queried;
+  const struct dbacl_row ***pattern_rows;
+
+  /* The deadline covers all of the queries needed for these paths. */
+  if (dbacl_timeout_ms > 0) {
+    dbacl_sql_deadline_ns = dbacl_stats_now() +
+      ((uint64_t) dbacl_timeout_ms * 1000000ULL);
+  }
+
+  dbacl_generation_check(p);
+
+  dps = pcalloc(p, npaths * sizeof(struct dbacl_path *));
+  queried = pcalloc(p, npaths * sizeof(int));
+  pattern_rows = pcalloc(p, npaths * sizeof(const struct dbacl_row **));
+  query_elts = make_array(p, 0, sizeof(struct dbacl_path_elt));
+
+  /* Rows of the components seen so far, whether from the cache or to be
+   * queried, keyed on path.  The rows to be queried start out as not
+   * existing, and are filled in as the query results are read.
+   */
+  row_tab = pr_table_nalloc(p, 0, npaths > 32 ? npaths : 32);
+
+  max_ents = INT_MAX;
+  (void) pr_table_ctl(row_tab, PR_TABLE_CTL_SET_MAX_ENTS, &max_ents);
+
+  for (i = 0; i < npaths; i++) {
+    register int j;
+    struct dbacl_path *dp;
+    unsigned int depth = 0;
+    int first_elt;
+
+    memset(&rows[i], 0, sizeof(struct dbacl_row));
+
+    if (dbacl_snapshot_get(paths[i], &rows[i]) == 0) {
+      pr_trace_msg(trace_channel, 9, "using snapshot row for path '%s'",
+        paths[i]);
+      continue;
+    }
+
+    if (dbacl_backend == DBACL_BACKEND_FILE) {
+      if (dbacl_file_get(paths[i], &rows[i], &depth) < 0) {
+        int xerrno = errno;
+
+        pr_trace_msg(trace_channel, 4,
+          "error getting DBACLBackend file row for path '%s': %s", paths[i],
+          strerror(xerrno));
+
+        dbacl_sql_deadline_ns = 0;
+        errno = xerrno;
+        return -1;
+      }
+
+      pr_trace_msg(trace_channel, 9, "using file row for path '%s'",
+        paths[i]);
+      (void) dbacl_patterns_apply(p, paths[i], depth, &rows[i]);
+      continue;
+    }
+
+    if (dbacl_preload_get(&dbacl_preloaded, paths[i], &rows[i],
+        &depth) == 0) {
+      pr_trace_msg(trace_channel, 9, "using preloaded row for path '%s'",
+        paths[i]);
+      (void) dbacl_patterns_apply(p, paths[i], depth, &rows[i]);
+      continue;
+    }
+
+    if (dbacl_preload_get(&dbacl_prefetched, paths[i], &rows[i],
+        &depth) == 0) {
+      pr_trace_msg(trace_channel, 9, "using prefetched row for path '%s'",
+        paths[i]);
+      (void) dbacl_patterns_apply(p, paths[i], depth, &rows[i]);
+      continue;
+    }
+
+    dp = dbacl_split_path(p, paths[i]);
+    if (dp == NULL) {
+      int xerrno = errno;
+
+      pr_trace_msg(trace_channel, 4,
+        "error splitting path '%s': %s", paths[i], strerror(xerrno));
+
+      dbacl_sql_deadline_ns = 0;
+      errno = xerrno;
+      return -1;
+    }
+
+    dps[i] = dp;
+
+    if (pr_trace_get_level(trace_channel) >= 9) {
+      register unsigned int k;
+
+      pr_trace_msg(trace_channel, 9,
+        "split path '%s' into the following list:", paths[i]);
+
+      for (k = 0; k < dp->ncomponents; k++) {
+        pr_trace_msg(trace_channel, 9,
+          "path component #%u: '%.*s'", k+1, (int) dp->lens[k], dp->path);
+      }
+    }
+
+    pattern_rows[i] = dbacl_patterns_match(p, dp);
+
+    /* Check each component, starting with the longest.  The first known
+     * row found is the longest match, unless one of the longer, unknown
+     * components has a row.  Likewise, the components shorter than one
+     * matching a pattern need not be checked.
+     */
+    first_elt = query_elts->nelts;
+
+    for (j = dp->ncomponents - 1; j >= 0; j--) {
+      const struct dbacl_row *known_row;
+      struct dbacl_row *new_row;
+      struct dbacl_path_elt *elt;
+      size_t len;
+
+      if (pattern_rows[i] != NULL &&
+          j + 1 < (int) dp->ncomponents &&
+          pattern_rows[i][j + 1] != NULL) {
+        break;
+      }
+
+      len = dp->lens[j];
+
+      known_row = pr_table_kget(row_tab, dp->path, len, NULL);
+      if (known_row != NULL) {
+        if (known_row->exists) {
+          break;
+        }
+
+        continue;
+      }
+
+      new_row = pcalloc(p, sizeof(struct dbacl_row));
+
+      if (!dbacl_bloom_has(dp->path, len)) {
+        (void) pr_table_kadd(row_tab, dp->path, len, new_row,
+          sizeof(struct dbacl_row));
+
+        pr_trace_msg(trace_channel, 9,
+          "path '%.*s' not in Bloom filter, not querying", (int) len,
+          dp->path);
+        dbacl_stats_bloom_skipped++;
+        continue;
+      }
+
+      if (dbacl_cache_lookup(dp->path, len, new_row) == 0) {
+        (void) pr_table_kadd(row_tab, dp->path, len, new_row,
+          sizeof(struct dbacl_row));
+
+        if (new_row->exists) {
+          pr_trace_msg(trace_channel, 9, "using cached row for path '%.*s'",
+            (int) len, dp->path);
+          break;
+        }
+
+        continue;
+      }
+
+      /* A component in a directory with no rows for any of its entries has
+       * no row either, and so inherits that of the directory.  Whether the
+       * path's own directory has such rows is queried, if not known; for
+       * its ancestors, only what is already known is used.
+       */
+      if ((dbacl_opts & DBACL_OPT_INHERIT_DIR_ROWS) &&
+          dbacl_dir_has_rows(p, row_tab, dp, j,
+            j == (int) dp->ncomponents - 1) == FALSE) {
+        (void) pr_table_kadd(row_tab, dp->path, len, new_row,
+          sizeof(struct dbacl_row));
+
+        pr_trace_msg(trace_channel, 9,
+          "no rows in directory of path '%.*s', not querying", (int) len,
+          dp->path);
+        dbacl_stats_dir_inherited++;
+        continue;
+      }
+
+      (void) pr_table_kadd(row_tab, dp->path, len, new_row,
+        sizeof(struct dbacl_row));
+
+      elt = push_array(query_elts);
+      elt->path = dp;
+      elt->idx = j;
+    }
+
+    if (query_elts->nelts == first_elt) {
+      continue;
+    }
+
+    /* Some components would have to be queried; the row for the entire
+     * path may have been resolved already, by any session using the same
+     * Redis server.  If so, its components are not queried after all.
+     */
+    if (dbacl_redis_get(p, paths[i], &rows[i]) == 0) {
+      int k;
+
+      elts = query_elts->elts;
+      for (k = first_elt; k < query_elts->nelts; k++) {
+        (void) pr_table_kremove(row_tab, elts[k].path->path,
+          elts[k].path->lens[elts[k].idx], NULL);
+      }
+
+      query_elts->nelts = first_elt;
+      dps[i] = NULL;
+
+      pr_trace_msg(trace_channel, 9, "using Redis row for path '%s'",
+        paths[i]);
+      continue;
+    }
+
+    queried[i] = TRUE;
+  }
+
+  elts = query_elts->elts;
+  for (i = 0; i < query_elts->nelts; i += DBACL_QUERY_MAX_PATHS) {
+    register unsigned int j;
+    array_header *sql_data;
+    unsigned int chunk_len;
+    char **values;
+
+    chunk_len = query_elts->nelts - i;
+    if (chunk_len > DBACL_QUERY_MAX_PATHS) {
+      chunk_len = DBACL_QUERY_MAX_PATHS;
+    }
+
+    sql_data = dbacl_get_rows(p, elts + i, chunk_len);
+    if (sql_data == NULL) {
+      dbacl_sql_deadline_ns = 0;
+      return -1;
+    }
+
+    values = sql_data->elts;
+    for (j = 0; j < sql_data->nelts; j += dbacl_row_ncols) {
+      register unsigned int k;
+      struct dbacl_row fetched_row;
+      const char *fetched_path;
+      size_t fetched_pathlen;
+
+      fetched_path = values[j];
+      if (fetched_path == NULL) {
+        continue;
+      }
+
+      fetched_pathlen = strlen(fetched_path);
+
+      fetched_row.exists = TRUE;
+      dbacl_parse_row(values + j + 1, fetched_row.acls);
+
+      /* The database may compare paths case-insensitively, and so return
+       * rows for paths differing only in case; paths are matched
+       * case-sensitively, as by the filesystem, and the preload tries, the
+       * snapshot and the DBACLBackend file.  As with a LIMIT 1 query, only
+       * the first row for a given path is used.
+       */
+      for (k = 0; k < chunk_len; k++) {
+        struct dbacl_row *known_row;
+        const char *path;
+        size_t len;
+
+        path = elts[i + k].path->path;
+        len = elts[i + k].path->lens[elts[i + k].idx];
+
+        if (fetched_pathlen != len ||
+            strncmp(fetched_path, path, len) != 0) {
+          continue;
+        }
+
+        known_row = (struct dbacl_row *) pr_table_kget(row_tab, path, len,
+          NULL);
+        if (known_row != NULL &&
+            known_row->exists == FALSE) {
+          memcpy(known_row, &fetched_row, sizeof(struct dbacl_row));
+        }
+      }
+    }
+  }
+
+  if (dbacl_cache_engine ||
+      dbacl_shm_slots != NULL) {
+    /* Cache the rows found, and the lack of rows for the other queried
+     * components.
+     */
+    for (i = 0; i < query_elts->nelts; i++) {
+      const struct dbacl_row *known_row;
+      const char *path;
+      size_t len;
+
+      path = elts[i].path->path;
+      len = elts[i].path->lens[elts[i].idx];
+
+      known_row = pr_table_kget(row_tab, path, len, NULL);
+      if (known_row != NULL) {
+        dbacl_cache_store(path, len, known_row);
+      }
+    }
+  }
+
+  for (i = 0; i < npaths; i++) {
+    register int j;
+    struct dbacl_path *dp;
+
+    dp = dps[i];
+    if (dp == NULL) {
+      /* Already resolved from the snapshot, file, preloaded or Redis
+       * rows.
+       */
+      continue;
+    }
+
+    /* For the same component, a row for the path itself is preferred over
+     * that of a pattern.
+     */
+    for (j = dp->ncomponents - 1; j >= 0; j--) {
+      const struct dbacl_row *known_row;
+
+      known_row = pr_table_kget(row_tab, dp->path, dp->lens[j], NULL);
+      if (known_row != NULL &&
+          known_row->exists) {
+        memcpy(&rows[i], known_row, sizeof(struct dbacl_row));
+        break;
+      }
+
+      if (pattern_rows[i] != NULL &&
+          pattern_rows[i][j] != NULL) {
+        pr_trace_msg(trace_channel, 9,
+          "using pattern row for component '%.*s' of path '%s'",
+          (int) dp->lens[j], dp->path, paths[i]);
+        memcpy(&rows[i], pattern_rows[i][j], sizeof(struct dbacl_row));
+        break;
+      }
+    }
+
+    if (queried[i]) {
+      dbacl_redis_put(p, paths[i], &rows[i]);
+    }
+  }
+
+  dbacl_sql_deadline_ns = 0;
+  return 0;
+}
+
+/* Looks up the given ACL for each of the given paths, resolving them
+ * together.  Access is denied if any path is denied, and allowed only if all
+ * of the paths are allowed; otherwise, the ACL is not found.
+ */
+static int dbacl_get_path_acl(cmd_rec *cmd, int acl, char **paths,
+    struct dbacl_row *rows, unsigned int npaths, int *policy) {
+  register unsigned int i;
+  unsigned int found = 0;
+  const char *acl_col;
+  char *cmd_name;
+
+  acl_col = dbacl_get_acl_col(acl);
+  if (acl_col == NULL) {
+    pr_trace_msg(trace_channel, 4,
+      "unknown ACL %d for path '%s'", acl, paths[0]);
+    errno = EINVAL;
+    return -1;
+  }
+
+  cmd_name = cmd->argv[0];
+  if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0) {
+    cmd_name = pstrcat(cmd->tmp_pool, cmd->argv[0], " ", cmd->argv[1], NULL);
+  }
+
+  for (i = 0; i < npaths; i++) {
+    int value;
+
+    value = rows[i].exists ? rows[i].acls[acl] : DBACL_VALUE_NONE;
+
+    if (value == DBACL_VALUE_NONE) {
+      pr_trace_msg(trace_channel, 4,
+        "error getting database row for ACL column '%s', path '%s': %s",
+        acl_col, paths[i], strerror(ENOENT));
+      continue;
+    }
+
+    if (value == DBACL_VALUE_DENY) {
+      pr_trace_msg(trace_channel, 9,
+        "command '%s' on path '%s' explicitly denied by table '%s', "
+        "column '%s'", cmd_name, paths[i], dbacl_table, acl_col);
+
+      *policy = DBACL_POLICY_DENY;
+      return FALSE;
+    }
+
+    pr_trace_msg(trace_channel, 9,
+      "command '%s' on path '%s' explicitly allowed by table '%s', "
+      "column '%s'", cmd_name, paths[i], dbacl_table, acl_col);
+    found++;
+  }
+
+  if (found < npaths) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  *policy = DBACL_POLICY_ALLOW;
+  return TRUE;
+}
+
+static int dbacl_get_acl(cmd_rec *cmd, int acl, int *policy) {
+  char *paths[2];
+  struct dbacl_row *rows = NULL;
+  unsigned int npaths;
+  int res;
+
+  if (acl == DBACL_ACL_UNMAPPED) {
+    pr_trace_msg(trace_channel, 4,
+      "no mapping of command '%s' to ACL column", cmd->argv[0]);
+    errno = ENOENT;
+    return -1;
+  }
+
+  if (dbacl_proto_id == DBACL_PROTO_OTHER) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  if (dbacl_get_paths(cmd, paths, &npaths) < 0) {
+    pr_trace_msg(trace_channel, 4,
+      "unable to get full path for command '%s'", cmd->argv[0]);
+    return -1;
+  }
+
+  /* Entering or listing a directory is usually followed by commands on its
+   * entries; load all of their rows now, with the directory's own row, using
+   * one query.
+   */
+  if (dbacl_prefetch_engine == TRUE &&
+      npaths == 1 &&
+      dbacl_is_prefetch_cmd(cmd) == TRUE) {
+    dbacl_prefetch(cmd->tmp_pool, paths[0]);
+  }
+
+  if (dbacl_is_handle_cmd(cmd) == TRUE) {
+    struct dbacl_handle *dh;
+
+    /* Any change of generation, or of the DBACLBackend file, discards the
+     * rows of the open handles.
+     */
+    dbacl_generation_check(cmd->tmp_pool);
+    dbacl_file_check();
+
+    dh = dbacl_handle_get(paths[0]);
+    if (dh != NULL) {
+      pr_trace_msg(trace_channel, 9,
+        "using row of open handle for path '%s'", paths[0]);
+      rows = &(dh->row);
+    }
+  }
+
+  if (rows == NULL) {
+    rows = palloc(cmd->tmp_pool, npaths * sizeof(struct dbacl_row));
+
+    res = dbacl_resolve_paths(cmd->tmp_pool, paths, npaths, rows);
+    if (res < 0) {
+      int xerrno = errno;
+
+      pr_trace_msg(trace_channel, 4,
+        "error getting database row for ACL column '%s', path '%s': %s",
+        dbacl_get_acl_col(acl), paths[0], strerror(xerrno));
+
+      errno = xerrno;
+      return -1;
+    }
+  }
+
+  res = dbacl_get_path_acl(cmd, acl, paths, rows, npaths, policy);
+
+  /* Keep the row for the requests made using the handle being opened,
+   * unless the open is to be rejected.
+   */
+  if (dbacl_is_handle_open_cmd(cmd) == TRUE &&
+      (res == TRUE ||
+       (res < 0 &&
+        errno == ENOENT &&
+        dbacl_policy == DBACL_POLICY_ALLOW))) {
+    int xerrno = errno;
+
+    if (dbacl_handle_open(paths[0], &rows[0]) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "error keeping row for handle on path '%s': %s", paths[0],
+        strerror(errno));
+    }
+
+    errno = xerrno;
+  }
+
+  if (res < 0) {
+    return res;
+  }
+
+  return 0;
+}
+
+/* Listing filters
+ */
+
+static int dbacl_is_listing_cmd(cmd_rec *cmd) {
+  if (pr_cmd_cmp(cmd, PR_CMD_LIST_ID) == 0 ||
+      pr_cmd_cmp(cmd, PR_CMD_NLST_ID) == 0 ||
+      pr_cmd_cmp(cmd, PR_CMD_MLSD_ID) == 0 ||
+      pr_cmd_strcmp(cmd, "OPENDIR") == 0) {
+    return TRUE;
+  }
+
+  /* STAT with a path lists that path over the control connection. */
+  if (pr_cmd_cmp(cmd, PR_CMD_STAT_ID) == 0 &&
+      cmd->argc > 1) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+static struct dbacl_dir *dbacl_dir_get(void *dirh) {
+  struct dbacl_dir *dir;
+
+  for (dir = dbacl_dirs; dir != NULL; dir = dir->next) {
+    if (dir->dirh == dirh) {
+      return dir;
+    }
+  }
+
+  return NULL;
+}
+
+/* Reads all of the entries of the directory, then looks up the rows for
+ * all of them at once, keeping only the entries whose VIEW ACL allows them
+ * to be seen.
+ */
+static int dbacl_dir_load(pr_fs_t *fs, struct dbacl_dir *dir) {
+  register unsigned int i;
+  pool *tmp_pool;
+  array_header *dirents;
+  struct dirent *dent, **dents;
+  struct dbacl_row *rows;
+  char **paths;
+  int res;
+
+  dirents = make_array(dir->pool, 0, sizeof(struct dirent *));
+
+  while ((dent = (fs->readdir)(fs, dir->dirh)) != NULL) {
+    struct dirent *copy;
+
+    pr_signals_handle();
+
+    copy = palloc(dir->pool, sizeof(struct dirent));
+    memcpy(copy, dent, sizeof(struct dirent));
+    *((struct dirent **) push_array(dirents)) = copy;
+  }
+
+  dir->entries = palloc(dir->pool,
+    (dirents->nelts + 1) * sizeof(struct dirent *));
+  dir->nentries = 0;
+  dir->next_entry = 0;
+  dir->loaded = TRUE;
+
+  if (dirents->nelts == 0) {
+    return 0;
+  }
+
+  tmp_pool = make_sub_pool(dir->pool);
+  pr_pool_tag(tmp_pool, "DBACL listing pool");
+
+  dents = dirents->elts;
+  paths = palloc(tmp_pool, dirents->nelts * sizeof(char *));
+  rows = palloc(tmp_pool, dirents->nelts * sizeof(struct dbacl_row));
+
+  for (i = 0; i < dirents->nelts; i++) {
+    paths[i] = pdircat(tmp_pool, dir->path, dents[i]->d_name, NULL);
+  }
+
+  res = dbacl_resolve_paths(tmp_pool, paths, dirents->nelts, rows);
+  if (res < 0) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 4,
+      "error getting database rows for entries of '%s': %s", dir->path,
+      strerror(xerrno));
+  }
+
+  for (i = 0; i < dirents->nelts; i++) {
+    const char *name;
+    int value = DBACL_VALUE_NONE;
+
+    name = dents[i]->d_name;
+
+    /* The directory itself, and its parent, are never hidden. */
+    if (strcmp(name, ".") == 0 ||
+        strcmp(name, "..") == 0) {
+      dir->entries[dir->nentries++] = dents[i];
+      continue;
+    }
+
+    if (res == 0 &&
+        rows[i].exists) {
+      value = rows[i].acls[DBACL_ACL_VIEW];
+    }
+
+    if (value == DBACL_VALUE_DENY ||
+        (value == DBACL_VALUE_NONE &&
+         dbacl_policy == DBACL_POLICY_DENY)) {
+      pr_trace_msg(trace_channel, 9,
+        "hiding '%s' from listing: denied by table '%s', column '%s'%s",
+        paths[i], dbacl_table, dbacl_view_col,
+        value == DBACL_VALUE_NONE ? " (DBACLPolicy deny)" : "");
+      continue;
+    }
+
+    dir->entries[dir->nentries++] = dents[i];
+  }
+
+  pr_trace_msg(trace_channel, 8, "listing %u of %d entries of '%s'",
+    dir->nentries, dirents->nelts, dir->path);
+
+  destroy_pool(tmp_pool);
+  return 0;
+}
+
+static void *dbacl_fs_opendir(pr_fs_t *fs, const char *path) {
+  pr_fs_t *next_fs;
+  struct dbacl_dir *dir;
+  pool *dir_pool;
+  const char *abs_path;
+  void *dirh;
+
+  /* Find the next FS with an opendir handler, as the FSIO API does. */
+  next_fs = fs->fs_next;
+  while (next_fs->fs_next != NULL &&
+         next_fs->opendir == NULL) {
+    next_fs = next_fs->fs_next;
+  }
+
+  dirh = (next_fs->opendir)(next_fs, path);
+  if (dirh == NULL ||
+      dbacl_listing == FALSE) {
+    return dirh;
+  }
+
+  dir_pool = make_sub_pool(session.pool);
+  pr_pool_tag(dir_pool, "DBACL directory pool");
+
+  abs_path = dir_abs_path(dir_pool, path, TRUE);
+  if (abs_path == NULL) {
+    pr_trace_msg(trace_channel, 4,
+      "error resolving '%s', not filtering its entries: %s", path,
+      strerror(errno));
+    destroy_pool(dir_pool);
+    return dirh;
+  }
+
+  dir = pcalloc(dir_pool, sizeof(struct dbacl_dir));
+  dir->pool = dir_pool;
+  dir->dirh = dirh;
+  dir->path = abs_path;
+
+  dir->next = dbacl_dirs;
+  dbacl_dirs = dir;
+
+  return dirh;
+}
+
+static struct dirent *dbacl_fs_readdir(pr_fs_t *fs, void *dirh) {
+  pr_fs_t *next_fs;
+  struct dbacl_dir *dir;
+
+  next_fs = fs->fs_next;
+  while (next_fs->fs_next != NULL &&
+         next_fs->readdir == NULL) {
+    next_fs = next_fs->fs_next;
+  }
+
+  dir = dbacl_dir_get(dirh);
+  if (dir == NULL) {
+    return (next_fs->readdir)(next_fs, dirh);
+  }
+
+  if (dir->loaded == FALSE) {
+    (void) dbacl_dir_load(next_fs, dir);
+  }
+
+  if (dir->next_entry >= dir->nentries) {
+    return NULL;
+  }
+
+  return dir->entries[dir->next_entry++];
+}
+
+static int dbacl_fs_closedir(pr_fs_t *fs, void *dirh) {
+  pr_fs_t *next_fs;
+  struct dbacl_dir *dir, *prev = NULL;
+
+  next_fs = fs->fs_next;
+  while (next_fs->fs_next != NULL &&
+         next_fs->closedir == NULL) {
+    next_fs = next_fs->fs_next;
+  }
+
+  for (dir = dbacl_dirs; dir != NULL; prev = dir, dir = dir->next) {
+    if (dir->dirh == dirh) {
+      if (prev != NULL) {
+        prev->next = dir->next;
+
+      } else {
+        dbacl_dirs = dir->next;
+      }
+
+      destroy_pool(dir->pool);
+      break;
+    }
+  }
+
+  return (next_fs->closedir)(next_fs, dirh);
+}
+
+static void dbacl_set_error_response(cmd_rec *cmd, const char *msg) {
+
+  /* Command-specific error code/message */
+  if (pr_cmd_cmp(cmd, PR_CMD_CDUP_ID) == 0 ||
+      pr_cmd_cmp(cmd, PR_CMD_XCUP_ID) == 0) {
+    pr_response_add_err(R_550, "%s", msg);
+
+  } else if (pr_cmd_cmp(cmd, PR_CMD_LIST_ID) == 0 ||
+             pr_cmd_cmp(cmd, PR_CMD_NLST_ID) == 0) {
+    size_t arglen;
+
+    /* We have may received bare LIST/NLST commands, or just options and no
+     * paths.  Do The Right Thing(tm) with these scenarios.
+     */
+
+    arglen = strlen(cmd->arg);
+    if (arglen == 0) {
+      /* No options, no path. */
+      pr_response_add_err(R_450, ".: %s", msg);
+
+    } else {
+      char *path;
+
+      path = dbacl_get_path_skip_opts(cmd);
+
+      arglen = strlen(path);
+      if (arglen == 0) {
+        /* Only options, no path. */
+        pr_response_add_err(R_450, ".: %s", msg);
+
+      } else {
+        pr_response_add_err(R_450, "%s: %s", cmd->arg, msg);
+      }
+    }
+
+  } else if (pr_cmd_cmp(cmd, PR_CMD_MFMT_ID) == 0 ||
+             pr_cmd_cmp(cmd, PR_CMD_MFF_ID) == 0) {
+    pr_response_add_err(R_550, "%s: %s", cmd->argv[2], msg);
+
+  } else if (pr_cmd_cmp(cmd, PR_CMD_MLSD_ID) == 0 ||
+             pr_cmd_cmp(cmd, PR_CMD_MLST_ID) == 0) {
+    size_t arglen;
+
+    arglen = strlen(cmd->arg);
+    if (arglen == 0) {
+
+      /* No path. */
+      pr_response_add_err(R_550, ".: %s", msg);
+
+    } else {
+      pr_response_add_err(R_550, "%s: %s", cmd->arg, msg);
+    }
+
+  } else if (pr_cmd_cmp(cmd, PR_CMD_STAT_ID) == 0) {
+    size_t arglen;
+
+    arglen = strlen(cmd->arg);
+    if (arglen == 0) {
+
+      /* No path. */
+      pr_response_add_err(R_550, "%s", msg);
+
+    } else {
+      pr_response_add_err(R_550, "%s: %s", cmd->arg, msg);
+    }
+
+  } else if (pr_cmd_cmp(cmd, PR_CMD_PWD_ID) == 0 ||
+             pr_cmd_cmp(cmd, PR_CMD_XPWD_ID) == 0) {
+    pr_response_add_err(R_550, "%s", msg);
+
+  } else if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0) {
+    register unsigned int i;
+    char *arg = "";
+
+    if (cmd->argc > 1 &&
+        (strncasecmp(cmd->argv[1], "CHMOD", 6) == 0 ||
+         strncasecmp(cmd->argv[1], "CHGRP", 6) == 0)) {
+
+      for (i = 3; i < cmd->argc; i++) {
+        arg = pstrcat(cmd->tmp_pool, arg, *arg ? " " : "", cmd->argv[i], NULL);
+      }
+
+    } else {
+      /* XXX Refine this case for other SITE commands. */
+
+      for (i = 2; i < cmd->argc; i++) {
+        arg = pstrcat(cmd->tmp_pool, arg, *arg ? " " : "", cmd->argv[i], NULL);
+      }
+    }
+
+    pr_response_add_err(R_550, "%s: %s", arg, msg);
+
+  } else {
+    pr_response_add_err(R_550, "%s: %s", cmd->arg, msg);
+  }
+}
+
+/* XXX NOTES:
+ *
+ *  Look up relevant row, using _escaped_ path, acl name, uid/user, gid/group
+ *    Hint: index on the lookup columns: path, and columns in WHERE clause.
+ *    DBACLCheckIndexes verifies (and can create) that index.
+ */
+
+/* Configuration handlers
+ */
+
+/* usage: DBACLBackend sql|file:path */
+MODRET set_dbaclbackend(cmd_rec *cmd) {
+  config_rec *c;
+  int backend;
+  char *path = NULL;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  if (strcasecmp(cmd->argv[1], "sql") == 0) {
+    backend = DBACL_BACKEND_SQL;
+
+  } else if (strncasecmp(cmd->argv[1], "file:", 5) == 0) {
+    backend = DBACL_BACKEND_FILE;
+
+    path = cmd->argv[1] + 5;
+    if (pr_fs_valid_path(path) < 0) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "must be an absolute path: ",
+        path, NULL));
+    }
+
+  } else {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown backend: ",
+      cmd->argv[1], NULL));
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = backend;
+  c->argv[1] = pstrdup(c->pool, path);
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLBloomFilter on|off [bits-per-path [max-age]] */
+MODRET set_dbaclbloomfilter(cmd_rec *cmd) {
+  config_rec *c;
+  int engine;
+  unsigned int bits_per_path = DBACL_BLOOM_DEFAULT_BITS_PER_PATH;
+  unsigned int max_age = DBACL_BLOOM_DEFAULT_MAX_AGE;
+
+  if (cmd->argc < 2 ||
+      cmd->argc > 4) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  engine = get_boolean(cmd, 1);
+  if (engine == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  if (cmd->argc > 2) {
+    char *ptr = NULL;
+    long num;
+
+    num = strtol(cmd->argv[2], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted bits per path '",
+        cmd->argv[2], "'", NULL));
+    }
+
+    if (num <= 0 ||
+        num > 64) {
+      CONF_ERROR(cmd, "bits per path must be between 1 and 64");
+    }
+
+    bits_per_path = (unsigned int) num;
+  }
+
+  if (cmd->argc > 3) {
+    char *ptr = NULL;
+    long num;
+
+    num = strtol(cmd->argv[3], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted max age '",
+        cmd->argv[3], "'", NULL));
+    }
+
+    if (num <= 0) {
+      CONF_ERROR(cmd, "max age must be greater than zero");
+    }
+
+    max_age = (unsigned int) num;
+  }
+
+  c = add_config_param(cmd->argv[0], 3, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = engine;
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = bits_per_path;
+  c->argv[2] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[2]) = max_age;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLCache on|off [ttl [max-entries [max-size]]] */
+MODRET set_dbaclcache(cmd_rec *cmd) {
+  config_rec *c;
+  int engine;
+  unsigned int ttl = DBACL_CACHE_DEFAULT_TTL;
+  unsigned int max_entries = DBACL_CACHE_DEFAULT_MAX_ENTRIES;
+  size_t max_size = DBACL_CACHE_DEFAULT_MAX_SIZE;
+
+  if (cmd->argc < 2 ||
+      cmd->argc > 5) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  engine = get_boolean(cmd, 1);
+  if (engine == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  if (cmd->argc > 2) {
+    char *ptr = NULL;
+    long num;
+
+    num = strtol(cmd->argv[2], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted TTL '",
+        cmd->argv[2], "'", NULL));
+    }
+
+    if (num <= 0) {
+      CONF_ERROR(cmd, "TTL must be greater than zero");
+    }
+
+    ttl = (unsigned int) num;
+  }
+
+  if (cmd->argc > 3) {
+    char *ptr = NULL;
+    long num;
+
+    num = strtol(cmd->argv[3], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted max entries '",
+        cmd->argv[3], "'", NULL));
+    }
+
+    if (num <= 0) {
+      CONF_ERROR(cmd, "max entries must be greater than zero");
+    }
+
+    max_entries = (unsigned int) num;
+  }
+
+  if (cmd->argc > 4) {
+    char *ptr = NULL;
+    unsigned long num;
+
+    /* Allow an optional K/M suffix, e.g. "512K" or "1M". */
+    num = strtoul(cmd->argv[4], &ptr, 10);
+    if (ptr && *ptr) {
+      if (strcasecmp(ptr, "K") == 0 ||
+          strcasecmp(ptr, "KB") == 0) {
+        num *= 1024;
+
+      } else if (strcasecmp(ptr, "M") == 0 ||
+                 strcasecmp(ptr, "MB") == 0) {
+        num *= (1024 * 1024);
+
+      } else {
+        CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted max size '",
+          cmd->argv[4], "'", NULL));
+      }
+    }
+
+    if (num == 0) {
+      CONF_ERROR(cmd, "max size must be greater than zero");
+    }
+
+    max_size = (size_t) num;
+  }
+
+  c = add_config_param(cmd->argv[0], 4, NULL, NULL, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = engine;
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = ttl;
+  c->argv[2] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[2]) = max_entries;
+  c->argv[3] = palloc(c->pool, sizeof(size_t));
+  *((size_t *) c->argv[3]) = max_size;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLCheckIndexes on|off|create [column ...] */
+MODRET set_dbaclcheckindexes(cmd_rec *cmd) {
+  config_rec *c;
+  register unsigned int i;
+  int mode;
+  char *cols = NULL;
+
+  if (cmd->argc < 2) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  if (strcasecmp(cmd->argv[1], "create") == 0) {
+    mode = DBACL_CHECK_INDEXES_CREATE;
+
+  } else {
+    mode = get_boolean(cmd, 1);
+    if (mode == -1) {
+      CONF_ERROR(cmd, "expected Boolean parameter or 'create'");
+    }
+
+    if (cmd->argc > 2) {
+      CONF_ERROR(cmd, "index columns can only be given for 'create'");
+    }
+
+    mode = mode ? DBACL_CHECK_INDEXES_ON : DBACL_CHECK_INDEXES_OFF;
+  }
+
+  for (i = 2; i < cmd->argc; i++) {
+    cols = pstrcat(cmd->tmp_pool, cols != NULL ? cols : "",
+      cols != NULL ? ", " : "", cmd->argv[i], NULL);
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = mode;
+  c->argv[1] = pstrdup(c->pool, cols);
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLCircuitBreaker failures [backoff] */
+MODRET set_dbaclcircuitbreaker(cmd_rec *cmd) {
+  config_rec *c;
+  char *ptr = NULL;
+  long num;
+  unsigned int max_failures, backoff = DBACL_BREAKER_DEFAULT_BACKOFF;
+
+  if (cmd->argc < 2 ||
+      cmd->argc > 3) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  num = strtol(cmd->argv[1], &ptr, 10);
+  if (ptr && *ptr) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted failures '",
+      cmd->argv[1], "'", NULL));
+  }
+
+  if (num <= 0) {
+    CONF_ERROR(cmd, "failures must be greater than zero");
+  }
+
+  max_failures = (unsigned int) num;
+
+  if (cmd->argc > 2) {
+    ptr = NULL;
+
+    num = strtol(cmd->argv[2], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted backoff '",
+        cmd->argv[2], "'", NULL));
+    }
+
+    if (num <= 0) {
+      CONF_ERROR(cmd, "backoff must be greater than zero");
+    }
+
+    backoff = (unsigned int) num;
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[0]) = max_failures;
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = backoff;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLCommandMap command acl */
+MODRET set_dbaclcommandmap(cmd_rec *cmd) {
+  register unsigned int i;
+  config_rec *c;
+  char *name = "";
+  const char *acl_name;
+  int acl = DBACL_ACL_UNMAPPED;
+
+  if (cmd->argc < 3) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  /* The command may be given as several parameters, e.g. "SITE SYMLINK". */
+  for (i = 1; i < cmd->argc - 1; i++) {
+    name = pstrcat(cmd->tmp_pool, name, *name ? " " : "", cmd->argv[i], NULL);
+  }
+
+  acl_name = cmd->argv[cmd->argc - 1];
+  if (strcasecmp(acl_name, "none") != 0) {
+    for (i = 0; i < DBACL_ACL_COUNT; i++) {
+      if (strcasecmp(acl_name, dbacl_acl_names[i]) == 0) {
+        acl = (int) i;
+        break;
+      }
+    }
+
+    if (acl == DBACL_ACL_UNMAPPED) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown ACL '", acl_name, "'",
+        NULL));
+    }
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = dbacl_cmd_map_key(c->pool, name, NULL);
+  c->argv[1] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[1]) = acl;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLEngine on|off */
+MODRET set_dbaclengine(cmd_rec *cmd) {
+  int bool = -1;
+  config_rec *c = NULL;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  bool = get_boolean(cmd, 1);
+  if (bool == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
 
-      return 0;
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = pcalloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = bool;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLPrefetch on|off [levels] */
+MODRET set_dbaclprefetch(cmd_rec *cmd) {
+  config_rec *c;
+  int engine;
+  unsigned int levels = DBACL_PREFETCH_DEFAULT_LEVELS;
+
+  if (cmd->argc < 2 ||
+      cmd->argc > 3) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  engine = get_boolean(cmd, 1);
+  if (engine == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  if (cmd->argc > 2) {
+    char *ptr = NULL;
+    long num;
+
+    num = strtol(cmd->argv[2], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted levels '",
+        cmd->argv[2], "'", NULL));
     }
+
+    if (num <= 0 ||
+        num > 32) {
+      CONF_ERROR(cmd, "levels must be between 1 and 32");
+    }
+
+    levels = (unsigned int) num;
   }
 
-  errno = ENOSYS;
-  return -1;
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = engine;
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = levels;
+
+  return PR_HANDLED(cmd);
 }
 
-static void dbacl_set_error_response(cmd_rec *cmd, const char *msg) {
+/* usage: DBACLPreload off|subtree */
+MODRET set_dbaclpreload(cmd_rec *cmd) {
+  config_rec *c;
+  int preload;
 
-  /* Command-specific error code/message */
-  if (pr_cmd_cmp(cmd, PR_CMD_CDUP_ID) == 0 ||
-      pr_cmd_cmp(cmd, PR_CMD_XCUP_ID) == 0) {
-    pr_response_add_err(R_550, "%s", msg);
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_LIST_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_NLST_ID) == 0) {
-    size_t arglen;
+  if (strcasecmp(cmd->argv[1], "subtree") == 0) {
+    preload = DBACL_PRELOAD_SUBTREE;
 
-    /* We have may received bare LIST/NLST commands, or just options and no
-     * paths.  Do The Right Thing(tm) with these scenarios.
-     */
+  } else {
+    int bool;
 
-    arglen = strlen(cmd->arg);
-    if (arglen == 0) {
-      /* No options, no path. */
-      pr_response_add_err(R_450, ".: %s", msg);
+    bool = get_boolean(cmd, 1);
+    if (bool != FALSE) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown DBACLPreload '",
+        cmd->argv[1], "'", NULL));
+    }
 
-    } else {
-      char *path;
+    preload = DBACL_PRELOAD_NONE;
+  }
 
-      path = dbacl_get_path_skip_opts(cmd);
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = preload;
 
-      arglen = strlen(path);
-      if (arglen == 0) {
-        /* Only options, no path. */
-        pr_response_add_err(R_450, ".: %s", msg);
+  return PR_HANDLED(cmd);
+}
 
-      } else {
-        pr_response_add_err(R_450, "%s: %s", cmd->arg, msg);
-      }
-    }
+/* usage: DBACLGeneration query [interval] */
+MODRET set_dbaclgeneration(cmd_rec *cmd) {
+  config_rec *c;
+  char *query;
+  unsigned int interval = DBACL_GENERATION_DEFAULT_INTERVAL;
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_MFMT_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_MFF_ID) == 0) {
-    pr_response_add_err(R_550, "%s: %s", cmd->argv[2], msg);
+  if (cmd->argc < 2 ||
+      cmd->argc > 3) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_MLSD_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_MLST_ID) == 0) {
-    size_t arglen;
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
 
-    arglen = strlen(cmd->arg);
-    if (arglen == 0) {
+  /* The query is run as a FREEFORM SQLNamedQuery, and so is sent as is;
+   * the leading "SELECT" keyword may be omitted.
+   */
+  query = cmd->argv[1];
+  if (strncasecmp(query, "SELECT ", 7) != 0 &&
+      strncasecmp(query, "WITH ", 5) != 0) {
+    query = pstrcat(cmd->tmp_pool, "SELECT ", query, NULL);
+  }
 
-      /* No path. */
-      pr_response_add_err(R_550, ".: %s", msg);
+  if (cmd->argc > 2) {
+    char *ptr = NULL;
+    long num;
 
-    } else {
-      pr_response_add_err(R_550, "%s: %s", cmd->arg, msg);
+    num = strtol(cmd->argv[2], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted interval '",
+        cmd->argv[2], "'", NULL));
     }
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_STAT_ID) == 0) {
-    size_t arglen;
+    if (num <= 0) {
+      CONF_ERROR(cmd, "interval must be greater than zero");
+    }
 
-    arglen = strlen(cmd->arg);
-    if (arglen == 0) {
+    interval = (unsigned int) num;
+  }
 
-      /* No path. */
-      pr_response_add_err(R_550, "%s", msg);
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = pstrdup(c->pool, query);
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = interval;
 
-    } else {
-      pr_response_add_err(R_550, "%s: %s", cmd->arg, msg);
-    }
+  return PR_HANDLED(cmd);
+}
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_PWD_ID) == 0 ||
-             pr_cmd_cmp(cmd, PR_CMD_XPWD_ID) == 0) {
-    pr_response_add_err(R_550, "%s", msg);
+/* usage: DBACLOptions opt1 ... */
+MODRET set_dbacloptions(cmd_rec *cmd) {
+  config_rec *c = NULL;
+  register unsigned int i = 0;
+  unsigned long opts = 0UL;
 
-  } else if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0) {
-    register unsigned int i;
-    char *arg = "";
+  if (cmd->argc-1 == 0) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
 
-    if (strncasecmp(cmd->argv[1], "CHMOD", 6) == 0 ||
-        strncasecmp(cmd->argv[1], "CHGRP", 6) == 0) {
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
 
-      for (i = 3; i < cmd->argc; i++) {
-        arg = pstrcat(cmd->tmp_pool, arg, *arg ? " " : "", cmd->argv[i], NULL);
-      }
+  c = add_config_param(cmd->argv[0], 1, NULL);
 
-    } else {
-      /* XXX Refine this case for other SITE commands. */
+  for (i = 1; i < cmd->argc; i++) {
+    if (strcmp(cmd->argv[i], "FilterListings") == 0) {
+      opts |= DBACL_OPT_FILTER_LISTINGS;
 
-      for (i = 2; i < cmd->argc; i++) {
-        arg = pstrcat(cmd->tmp_pool, arg, *arg ? " " : "", cmd->argv[i], NULL);
-      }
+    } else if (strcmp(cmd->argv[i], "InheritDirectoryRows") == 0) {
+      opts |= DBACL_OPT_INHERIT_DIR_ROWS;
+
+    } else {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown DBACLOptions option: '",
+        cmd->argv[i], "'", NULL));
     }
+  }
 
-    pr_response_add_err(R_550, "%s: %s", arg, msg);
+  c->argv[0] = pcalloc(c->pool, sizeof(unsigned long));
+  *((unsigned long *) c->argv[0]) = opts;
 
-  } else {
-    pr_response_add_err(R_550, "%s: %s", cmd->arg, msg);
-  }
+  return PR_HANDLED(cmd);
 }
 
-/* XXX NOTES:
- *
- *  Look up relevant row, using _escaped_ path, acl name, uid/user, gid/group
- *    Hint: index on the lookup columns: path, and columns in WHERE clause.
- */
-
-/* Configuration handlers
- */
+/* usage: DBACLPatterns on|off [where-clause] */
+MODRET set_dbaclpatterns(cmd_rec *cmd) {
+  config_rec *c;
+  int engine;
+  char *clause = NULL;
 
-/* usage: DBACLEngine on|off */
-MODRET set_dbaclengine(cmd_rec *cmd) {
-  int bool = -1;
-  config_rec *c = NULL;
+  if (cmd->argc < 2 ||
+      cmd->argc > 3) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
 
-  CHECK_ARGS(cmd, 1);
   CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
 
-  bool = get_boolean(cmd, 1);
-  if (bool == -1) {
+  engine = get_boolean(cmd, 1);
+  if (engine == -1) {
     CONF_ERROR(cmd, "expected Boolean parameter");
   }
 
-  c = add_config_param(cmd->argv[0], 1, NULL);
-  c->argv[0] = pcalloc(c->pool, sizeof(int));
-  *((int *) c->argv[0]) = bool;
+  if (cmd->argc == 3) {
+    clause = cmd->argv[2];
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = engine;
+  c->argv[1] = pstrdup(c->pool, clause);
 
   return PR_HANDLED(cmd);
 }
@@ -855,48 +6481,247 @@ MODRET set_dbaclpolicy(cmd_rec *cmd) {
   } else if (strncasecmp(cmd->argv[1], "deny", 5) == 0) {
     policy = DBACL_POLICY_DENY;
 
-  } else {
-    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown DBACLPolicy '",
-      cmd->argv[1], "'", NULL));
+  } else {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown DBACLPolicy '",
+      cmd->argv[1], "'", NULL));
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = policy;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLQueryStrategy inlist|unionall|join|cte */
+MODRET set_dbaclquerystrategy(cmd_rec *cmd) {
+  config_rec *c;
+  int strategy;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  if (strcasecmp(cmd->argv[1], "inlist") == 0) {
+    strategy = DBACL_QUERY_STRATEGY_INLIST;
+
+  } else if (strcasecmp(cmd->argv[1], "unionall") == 0) {
+    strategy = DBACL_QUERY_STRATEGY_UNIONALL;
+
+  } else if (strcasecmp(cmd->argv[1], "join") == 0) {
+    strategy = DBACL_QUERY_STRATEGY_JOIN;
+
+  } else if (strcasecmp(cmd->argv[1], "cte") == 0) {
+    strategy = DBACL_QUERY_STRATEGY_CTE;
+
+  } else {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown DBACLQueryStrategy '",
+      cmd->argv[1], "'", NULL));
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = strategy;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLSchema table [path-col acls-col|cols] [conn-name] */
+MODRET set_dbaclschema(cmd_rec *cmd) {
+
+  if (cmd->argc-1 != 1 &&
+      cmd->argc-1 != 3 &&
+      cmd->argc-1 != 4 &&
+      cmd->argc-1 != 10 &&
+      cmd->argc-1 != 11) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  if (cmd->argc-1 == 1) {
+    /* Just the table name. */
+    (void) add_config_param_str(cmd->argv[0], 1, cmd->argv[1]);
+    return PR_HANDLED(cmd);
+
+  } else if (cmd->argc-1 == 3) {
+    /* Table name, path column name, and packed ACLs column name. */
+    (void) add_config_param_str(cmd->argv[0], 3, cmd->argv[1], cmd->argv[2],
+      cmd->argv[3]);
+
+  } else if (cmd->argc-1 == 4) {
+    /* Table name, path and packed ACLs column names, and connection name. */
+    (void) add_config_param_str(cmd->argv[0], 4, cmd->argv[1], cmd->argv[2],
+      cmd->argv[3], cmd->argv[4]);
+
+  } else if (cmd->argc-1 == 10) {
+    /* Table name and column names. */
+    (void) add_config_param_str(cmd->argv[0], 10, cmd->argv[1], cmd->argv[2],
+      cmd->argv[3], cmd->argv[4], cmd->argv[5], cmd->argv[6], cmd->argv[7],
+      cmd->argv[8], cmd->argv[9], cmd->argv[10]);
+
+  } else if (cmd->argc-1 == 11) {
+
+    /* Table name, column names, and connection name. */
+    (void) add_config_param_str(cmd->argv[0], 11, cmd->argv[1], cmd->argv[2],
+      cmd->argv[3], cmd->argv[4], cmd->argv[5], cmd->argv[6], cmd->argv[7],
+      cmd->argv[8], cmd->argv[9], cmd->argv[10], cmd->argv[11]);
+  }
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLSharedCache on|off [max-entries [ttl]] */
+MODRET set_dbaclsharedcache(cmd_rec *cmd) {
+  config_rec *c;
+  int engine;
+  unsigned int max_entries = DBACL_SHM_DEFAULT_MAX_ENTRIES;
+  unsigned int ttl = DBACL_SHM_DEFAULT_TTL;
+
+  if (cmd->argc < 2 ||
+      cmd->argc > 4) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  /* The shared cache is created by the daemon process, before any vhost
+   * is chosen.
+   */
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  engine = get_boolean(cmd, 1);
+  if (engine == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  if (cmd->argc > 2) {
+    char *ptr = NULL;
+    long num;
+
+    num = strtol(cmd->argv[2], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted max entries '",
+        cmd->argv[2], "'", NULL));
+    }
+
+    if (num <= 0) {
+      CONF_ERROR(cmd, "max entries must be greater than zero");
+    }
+
+    max_entries = (unsigned int) num;
+  }
+
+  if (cmd->argc > 3) {
+    char *ptr = NULL;
+    long num;
+
+    num = strtol(cmd->argv[3], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted TTL '",
+        cmd->argv[3], "'", NULL));
+    }
+
+    if (num <= 0) {
+      CONF_ERROR(cmd, "TTL must be greater than zero");
+    }
+
+    ttl = (unsigned int) num;
+  }
+
+  c = add_config_param(cmd->argv[0], 3, NULL, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = engine;
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = max_entries;
+  c->argv[2] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[2]) = ttl;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: DBACLRedis on|off [ttl] */
+MODRET set_dbaclredis(cmd_rec *cmd) {
+#ifdef PR_USE_REDIS
+  config_rec *c;
+  int engine;
+  unsigned int ttl = DBACL_REDIS_DEFAULT_TTL;
+
+  if (cmd->argc < 2 ||
+      cmd->argc > 3) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  engine = get_boolean(cmd, 1);
+  if (engine == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  if (cmd->argc > 2) {
+    char *ptr = NULL;
+    long num;
+
+    num = strtol(cmd->argv[2], &ptr, 10);
+    if (ptr && *ptr) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted TTL '",
+        cmd->argv[2], "'", NULL));
+    }
+
+    if (num <= 0) {
+      CONF_ERROR(cmd, "TTL must be greater than zero");
+    }
+
+    ttl = (unsigned int) num;
   }
 
-  c = add_config_param(cmd->argv[0], 1, NULL);
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
   c->argv[0] = palloc(c->pool, sizeof(int));
-  *((int *) c->argv[0]) = policy;
+  *((int *) c->argv[0]) = engine;
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = ttl;
 
   return PR_HANDLED(cmd);
+#else
+  CONF_ERROR(cmd, "requires proftpd built with Redis support (--enable-redis)");
+#endif /* PR_USE_REDIS */
 }
 
-/* usage: DBACLSchema table [cols] [conn-name] */
-MODRET set_dbaclschema(cmd_rec *cmd) {
+/* usage: DBACLSnapshot path */
+MODRET set_dbaclsnapshot(cmd_rec *cmd) {
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
 
-  if (cmd->argc-1 != 1 &&
-      cmd->argc-1 != 10 &&
-      cmd->argc-1 != 11) {
-    CONF_ERROR(cmd, "wrong number of parameters");
+  if (pr_fs_valid_path(cmd->argv[1]) < 0) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "must be an absolute path: ",
+      cmd->argv[1], NULL));
   }
 
-  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+  (void) add_config_param_str(cmd->argv[0], 1, cmd->argv[1]);
+  return PR_HANDLED(cmd);
+}
 
-  if (cmd->argc-1 == 1) {
-    /* Just the table name. */
-    (void) add_config_param_str(cmd->argv[0], 1, cmd->argv[1]);
-    return PR_HANDLED(cmd);
+/* usage: DBACLTimeout millisecs */
+MODRET set_dbacltimeout(cmd_rec *cmd) {
+  config_rec *c;
+  char *ptr = NULL;
+  long num;
 
-  } else if (cmd->argc-1 == 10) {
-    /* Table name and column names. */
-    (void) add_config_param_str(cmd->argv[0], 10, cmd->argv[1], cmd->argv[2],
-      cmd->argv[3], cmd->argv[4], cmd->argv[5], cmd->argv[6], cmd->argv[7],
-      cmd->argv[8], cmd->argv[9], cmd->argv[10]);
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
 
-  } else if (cmd->argc-1 == 11) {
+  num = strtol(cmd->argv[1], &ptr, 10);
+  if (ptr && *ptr) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "badly formatted timeout '",
+      cmd->argv[1], "'", NULL));
+  }
 
-    /* Table name, column names, and connection name. */
-    (void) add_config_param_str(cmd->argv[0], 11, cmd->argv[1], cmd->argv[2],
-      cmd->argv[3], cmd->argv[4], cmd->argv[5], cmd->argv[6], cmd->argv[7],
-      cmd->argv[8], cmd->argv[9], cmd->argv[10], cmd->argv[11]);
+  if (num <= 0) {
+    CONF_ERROR(cmd, "timeout must be greater than zero");
   }
 
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[0]) = (unsigned int) num;
+
   return PR_HANDLED(cmd);
 }
 
@@ -913,17 +6738,52 @@ MODRET set_dbaclwhereclause(cmd_rec *cmd) {
  */
 
 MODRET dbacl_pre_cmd(cmd_rec *cmd) {
-  int policy, res;
+  int acl, policy, res;
   const char *proto;
+  uint64_t start_ns;
 
   if (!dbacl_engine) {
     return PR_DECLINED(cmd);
   }
 
-  proto = pr_session_get_protocol(0);
+  /* Our own SITE DBACL commands are not subject to the ACLs. */
+  if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0 &&
+      cmd->argc > 1 &&
+      strncasecmp(cmd->argv[1], "DBACL", 6) == 0) {
+    return PR_DECLINED(cmd);
+  }
+
+  /* A bare SITE command names no SITE command, nor any path, to check. */
+  if (pr_cmd_cmp(cmd, PR_CMD_SITE_ID) == 0 &&
+      cmd->argc < 2) {
+    return PR_DECLINED(cmd);
+  }
+
+  /* Commands which are not mapped to any ACL are not checked; any SITE
+   * command without a mapping is still handled as unresolved, though.
+   */
+  acl = dbacl_cmd_map_get(cmd);
+  if (acl == DBACL_ACL_UNMAPPED &&
+      pr_cmd_cmp(cmd, PR_CMD_SITE_ID) != 0) {
+    return PR_DECLINED(cmd);
+  }
+
+  proto = dbacl_proto;
+
+  /* Any directories opened by an allowed listing command have their entries
+   * filtered; see dbacl_fs_opendir().
+   */
+  if (dbacl_opts & DBACL_OPT_FILTER_LISTINGS) {
+    dbacl_listing = dbacl_is_listing_cmd(cmd);
+  }
+
+  start_ns = dbacl_stats_now();
+  res = dbacl_get_acl(cmd, acl, &policy);
+  dbacl_stats_add(DBACL_STATS_PHASE_LOOKUP, start_ns);
 
-  res = dbacl_get_acl(cmd, proto, &policy);
   if (res < 0) {
+    dbacl_stats_unresolved++;
+
     if (dbacl_policy == DBACL_POLICY_DENY) {
       pr_trace_msg(trace_channel, 3,
         "error looking up ACL for %s command/resource (protocol '%s') "
@@ -939,6 +6799,8 @@ MODRET dbacl_pre_cmd(cmd_rec *cmd) {
   }
 
   if (policy == DBACL_POLICY_DENY) {
+    dbacl_stats_denied++;
+
     pr_trace_msg(trace_channel, 3,
       "configured ACL for %s command/resource (protocol '%s') denies "
       "access, rejecting command", cmd->argv[0], proto);
@@ -948,6 +6810,8 @@ MODRET dbacl_pre_cmd(cmd_rec *cmd) {
     return PR_ERROR(cmd);
   }
 
+  dbacl_stats_allowed++;
+
   pr_trace_msg(trace_channel, 9,
     "configured ACL for %s command/resource (protocol '%s') allows access, "
     "permitting command", cmd->argv[0], proto);
@@ -955,6 +6819,121 @@ MODRET dbacl_pre_cmd(cmd_rec *cmd) {
   return PR_DECLINED(cmd);
 }
 
+MODRET dbacl_site(cmd_rec *cmd) {
+  register unsigned int i;
+
+  if (!dbacl_engine) {
+    return PR_DECLINED(cmd);
+  }
+
+  if (cmd->argc < 2 ||
+      strncasecmp(cmd->argv[1], "DBACL", 6) != 0) {
+    return PR_DECLINED(cmd);
+  }
+
+  if (cmd->argc != 3 ||
+      strncasecmp(cmd->argv[2], "STATS", 6) != 0) {
+    pr_response_add_err(R_501, "%s", "Usage: SITE DBACL STATS");
+    return PR_ERROR(cmd);
+  }
+
+  pr_response_add(R_211, "ACL lookups: %lu allowed, %lu denied, %lu "
+    "unresolved", dbacl_stats_allowed, dbacl_stats_denied,
+    dbacl_stats_unresolved);
+
+  for (i = 0; i < DBACL_STATS_NPHASES; i++) {
+    struct dbacl_stats *stats;
+    double mean_us = 0.0;
+
+    stats = &(dbacl_stats[i]);
+    if (stats->count > 0) {
+      mean_us = (stats->total_ns / (double) stats->count) / 1000.0;
+    }
+
+    pr_response_add(R_211, "%s: %lu calls, mean %.1f us, p50 <= %lu us, "
+      "p99 <= %lu us, max %.1f us", stats->phase, stats->count, mean_us,
+      dbacl_stats_get_percentile(stats, 50),
+      dbacl_stats_get_percentile(stats, 99), stats->max_ns / 1000.0);
+  }
+
+  if (dbacl_timeout_ms > 0 ||
+      dbacl_breaker_max_failures > 0) {
+    const char *state;
+
+    switch (dbacl_breaker_state) {
+      case DBACL_BREAKER_OPEN:
+        state = "open";
+        break;
+
+      case DBACL_BREAKER_HALF_OPEN:
+        state = "half-open";
+        break;
+
+      default:
+        state = "closed";
+        break;
+    }
+
+    pr_response_add(R_211, "SQL queries: %lu slow, %lu skipped; circuit "
+      "breaker %s, tripped %lu times", dbacl_stats_slow_queries,
+      dbacl_stats_skipped_queries, state, dbacl_stats_breaker_trips);
+  }
+
+  if (dbacl_bloom_shared == TRUE) {
+    pr_response_add(R_211, "Bloom filter: %u paths, %lu bits (shared), %lu "
+      "path components not queried", dbacl_bloom_shm->npaths,
+      (unsigned long) dbacl_bloom_shm->nbits, dbacl_stats_bloom_skipped);
+
+  } else if (dbacl_bloom_bits != NULL) {
+    pr_response_add(R_211, "Bloom filter: %u paths, %lu bits, %lu path "
+      "components not queried", dbacl_bloom_npaths,
+      (unsigned long) dbacl_bloom_nbits, dbacl_stats_bloom_skipped);
+  }
+
+  if (dbacl_opts & DBACL_OPT_INHERIT_DIR_ROWS) {
+    pr_response_add(R_211, "Directory rows: %lu directories queried, %lu "
+      "path components not queried", dbacl_stats_dir_queries,
+      dbacl_stats_dir_inherited);
+  }
+
+  if (dbacl_redis_is_open()) {
+    pr_response_add(R_211, "Redis: %lu hits, %lu misses, %lu errors",
+      dbacl_stats_redis_hits, dbacl_stats_redis_misses,
+      dbacl_stats_redis_errors);
+  }
+
+  pr_response_add(R_211, "%s", "End of DBACL statistics");
+  return PR_HANDLED(cmd);
+}
+
+MODRET dbacl_post_cmd(cmd_rec *cmd) {
+  dbacl_listing = FALSE;
+  return PR_DECLINED(cmd);
+}
+
+/* mod_sftp logs the RETR, STOR or APPE command for an OPEN request when the
+ * handle is closed (or when the OPEN fails).
+ */
+MODRET dbacl_log_xfer(cmd_rec *cmd) {
+  char *path;
+
+  if (!dbacl_engine ||
+      dbacl_handle_tab == NULL) {
+    return PR_DECLINED(cmd);
+  }
+
+  if (dbacl_is_handle_open_cmd(cmd) == FALSE) {
+    return PR_DECLINED(cmd);
+  }
+
+  path = dbacl_get_path(cmd);
+  if (path != NULL) {
+    dbacl_handle_close(path);
+  }
+
+  return PR_DECLINED(cmd);
+}
+
 MODRET dbacl_post_pass(cmd_rec *cmd) {
   config_rec *c;
 
@@ -967,6 +6946,17 @@ MODRET dbacl_post_pass(cmd_rec *cmd) {
     return PR_DECLINED(cmd);
   }
 
+  dbacl_proto = pr_session_get_protocol(0);
+  if (strncasecmp(dbacl_proto, "ftp", 4) == 0 ||
+      strncasecmp(dbacl_proto, "ftps", 5) == 0) {
+    dbacl_proto_id = DBACL_PROTO_FTP;
+
+  } else if (strncasecmp(dbacl_proto, "sftp", 5) == 0) {
+    dbacl_proto_id = DBACL_PROTO_SFTP;
+  }
+
+  dbacl_cmd_map_init();
+
   c = find_config(main_server->conf, CONF_PARAM, "DBACLSchema", FALSE);
   if (c) {
     if (c->argc == 1) {
@@ -988,6 +6978,17 @@ MODRET dbacl_post_pass(cmd_rec *cmd) {
       if (c->argc == 11) {
         dbacl_conn_name = c->argv[10];
       }
+
+    } else if (c->argc >= 3) {
+      dbacl_table = c->argv[0];
+
+      dbacl_path_col = c->argv[1];
+      dbacl_acls_col = c->argv[2];
+      dbacl_row_ncols = 2;
+
+      if (c->argc == 4) {
+        dbacl_conn_name = c->argv[3];
+      }
     }
   }
 
@@ -997,7 +6998,13 @@ MODRET dbacl_post_pass(cmd_rec *cmd) {
 
     pr_trace_msg(trace_channel, 15,
       "using column name '%s' for paths", dbacl_path_col);
+  }
+
+  if (dbacl_acls_col != NULL) {
+    pr_trace_msg(trace_channel, 15,
+      "using column name '%s' for all ACLs, packed", dbacl_acls_col);
 
+  } else if (pr_trace_get_level(trace_channel) >= 15) {
     pr_trace_msg(trace_channel, 15,
       "using column name '%s' for the READ ACL", dbacl_read_col);
 
@@ -1033,63 +7040,386 @@ MODRET dbacl_post_pass(cmd_rec *cmd) {
     dbacl_where_clause = c->argv[0];
   }
 
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLPatterns", FALSE);
+  if (c) {
+    dbacl_patterns_engine = *((int *) c->argv[0]);
+    dbacl_patterns_clause = c->argv[1];
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLQueryStrategy", FALSE);
+  if (c) {
+    dbacl_query_strategy = *((int *) c->argv[0]);
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLCheckIndexes", FALSE);
+  if (c &&
+      dbacl_backend == DBACL_BACKEND_SQL) {
+    dbacl_check_indexes_mode = *((int *) c->argv[0]);
+    dbacl_check_indexes_cols = c->argv[1];
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLTimeout", FALSE);
+  if (c) {
+    dbacl_timeout_ms = *((unsigned int *) c->argv[0]);
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLCircuitBreaker",
+    FALSE);
+  if (c) {
+    dbacl_breaker_max_failures = *((unsigned int *) c->argv[0]);
+    dbacl_breaker_backoff = *((unsigned int *) c->argv[1]);
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLGeneration", FALSE);
+  if (c &&
+      dbacl_backend == DBACL_BACKEND_SQL) {
+    dbacl_generation_query = c->argv[0];
+    dbacl_generation_interval = *((unsigned int *) c->argv[1]);
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLCache", FALSE);
+  if (c) {
+    dbacl_cache_engine = *((int *) c->argv[0]);
+    dbacl_cache_ttl = *((unsigned int *) c->argv[1]);
+    dbacl_cache_max_entries = *((unsigned int *) c->argv[2]);
+    dbacl_cache_max_size = *((size_t *) c->argv[3]);
+
+  } else if (dbacl_generation_query != NULL) {
+    /* Keeping rows until the generation changes implies caching them. */
+    dbacl_cache_engine = TRUE;
+  }
+
+  if (dbacl_backend == DBACL_BACKEND_FILE) {
+    /* All of the rows are in memory; there is nothing for the cache, the
+     * preloading, prefetching, or the Bloom filter to save.
+     */
+    dbacl_cache_engine = FALSE;
+
+    if (dbacl_file_load() < 0) {
+      pr_log_pri(PR_LOG_NOTICE, MOD_DBACL_VERSION
+        ": error loading DBACLBackend file '%s': %s",
+        dbacl_file_name != NULL ? dbacl_file_name : "", strerror(errno));
+    }
+
+  } else if (dbacl_sql_init(cmd->tmp_pool) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error preparing SQL lookups: %s", strerror(errno));
+  }
+
+  if (dbacl_generation_query != NULL) {
+    /* Get the initial generation. */
+    dbacl_generation_check(cmd->tmp_pool);
+  }
+
+  if (dbacl_shm_slots != NULL &&
+      dbacl_backend == DBACL_BACKEND_FILE) {
+    dbacl_shm_slots = NULL;
+  }
+
+  if (dbacl_shm_slots != NULL) {
+    if (dbacl_shm_init(cmd->tmp_pool) == 0) {
+      pr_trace_msg(trace_channel, 15,
+        "using shared cache (%u entries, %u secs)", dbacl_shm_nslots,
+        dbacl_shm_ttl);
+
+    } else {
+      pr_trace_msg(trace_channel, 3,
+        "DBACLWhereClause uses variables other than %%u and %%g, "
+        "not using shared cache");
+
+      /* Our copy of the mapping is left in place; it is simply unused. */
+      dbacl_shm_slots = NULL;
+    }
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLRedis", FALSE);
+  if (c &&
+      dbacl_backend == DBACL_BACKEND_SQL) {
+    dbacl_redis_engine = *((int *) c->argv[0]);
+    dbacl_redis_ttl = *((unsigned int *) c->argv[1]);
+  }
+
+  if (dbacl_redis_engine) {
+    if (dbacl_redis_open(cmd->tmp_pool) == 0) {
+      pr_trace_msg(trace_channel, 15,
+        "using Redis for resolved rows (%u secs)", dbacl_redis_ttl);
+
+    } else {
+      pr_trace_msg(trace_channel, 3,
+        "error setting up Redis, not using Redis: %s",
+        strerror(errno));
+    }
+  }
+
+  if (dbacl_cache_engine) {
+    dbacl_cache_alloc();
+
+    pr_trace_msg(trace_channel, 15,
+      "caching ACL lookups for %u secs (max %u entries, %lu bytes)",
+      dbacl_cache_ttl, dbacl_cache_max_entries,
+      (unsigned long) dbacl_cache_max_size);
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLOptions", FALSE);
+  while (c != NULL) {
+    unsigned long opts;
+
+    pr_signals_handle();
+
+    opts = *((unsigned long *) c->argv[0]);
+    dbacl_opts |= opts;
+
+    c = find_config_next(c, c->next, CONF_PARAM, "DBACLOptions", FALSE);
+  }
+
+  if (dbacl_opts & DBACL_OPT_FILTER_LISTINGS) {
+    pr_fs_t *fs;
+
+    /* Register our FS at the root, on top of any other FS registered there,
+     * so that we see the directories opened for listings.
+     */
+    fs = pr_register_fs(session.pool, "dbacl", "/");
+    if (fs != NULL) {
+      fs->opendir = dbacl_fs_opendir;
+      fs->readdir = dbacl_fs_readdir;
+      fs->closedir = dbacl_fs_closedir;
+
+      pr_trace_msg(trace_channel, 15,
+        "filtering listed directory entries using the VIEW ACL");
+
+    } else {
+      pr_trace_msg(trace_channel, 3,
+        "error registering FS for filtering listings: %s", strerror(errno));
+    }
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLPrefetch", FALSE);
+  if (c &&
+      dbacl_backend == DBACL_BACKEND_SQL) {
+    dbacl_prefetch_engine = *((int *) c->argv[0]);
+    dbacl_prefetch_levels = *((unsigned int *) c->argv[1]);
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLPreload", FALSE);
+  if (c &&
+      dbacl_backend == DBACL_BACKEND_SQL) {
+    dbacl_preload = *((int *) c->argv[0]);
+  }
+
+  if (dbacl_preload == DBACL_PRELOAD_SUBTREE) {
+    char *root;
+
+    /* The session's current directory, at this point, is its home directory
+     * (or the root of its chroot).
+     */
+    root = dir_abs_path(cmd->tmp_pool, pr_fs_getcwd(), TRUE);
+    if (root != NULL) {
+      if (dbacl_preload_rows(cmd->tmp_pool, &dbacl_preloaded, root, 0) < 0) {
+        pr_trace_msg(trace_channel, 3,
+          "error preloading rows for '%s': %s", root, strerror(errno));
+      }
+
+    } else {
+      pr_trace_msg(trace_channel, 3,
+        "error resolving home directory for preloading rows: %s",
+        strerror(errno));
+    }
+  }
+
+  if (dbacl_backend == DBACL_BACKEND_SQL &&
+      dbacl_patterns_engine == TRUE) {
+    if (dbacl_patterns_load(cmd->tmp_pool) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "error loading patterns: %s", strerror(errno));
+    }
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLBloomFilter", FALSE);
+  if (c &&
+      dbacl_backend == DBACL_BACKEND_SQL) {
+    dbacl_bloom_engine = *((int *) c->argv[0]);
+    dbacl_bloom_bits_per_path = *((unsigned int *) c->argv[1]);
+    dbacl_bloom_max_age = *((unsigned int *) c->argv[2]);
+  }
+
+  if (dbacl_bloom_engine) {
+    if (dbacl_bloom_build(cmd->tmp_pool) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "error building Bloom filter: %s", strerror(errno));
+    }
+  }
+
   return PR_DECLINED(cmd);
 }
 
+/* Event handlers
+ */
+
+static void dbacl_exit_ev(const void *event_data, void *user_data) {
+  unsigned long nlookups;
+
+  dbacl_redis_close();
+
+  nlookups = dbacl_stats_allowed + dbacl_stats_denied + dbacl_stats_unresolved;
+  if (nlookups == 0) {
+    return;
+  }
+
+  pr_log_pri(PR_LOG_INFO, MOD_DBACL_VERSION
+    ": %lu ACL lookups (%lu allowed, %lu denied, %lu unresolved) in %.3f ms: "
+    "path %.3f ms, escape %.3f ms, query %.3f ms, sql %.3f ms (%lu queries)",
+    nlookups, dbacl_stats_allowed, dbacl_stats_denied, dbacl_stats_unresolved,
+    dbacl_stats[DBACL_STATS_PHASE_LOOKUP].total_ns / 1000000.0,
+    dbacl_stats[DBACL_STATS_PHASE_PATH].total_ns / 1000000.0,
+    dbacl_stats[DBACL_STATS_PHASE_ESCAPE].total_ns / 1000000.0,
+    dbacl_stats[DBACL_STATS_PHASE_QUERY].total_ns / 1000000.0,
+    dbacl_stats[DBACL_STATS_PHASE_SQL].total_ns / 1000000.0,
+    dbacl_stats[DBACL_STATS_PHASE_SQL].count);
+}
+
+static void dbacl_postparse_ev(const void *event_data, void *user_data) {
+  config_rec *c;
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLBloomFilter", FALSE);
+  if (c != NULL &&
+      *((int *) c->argv[0]) == TRUE) {
+    if (dbacl_bloom_shm_create() < 0) {
+      pr_log_pri(PR_LOG_NOTICE, MOD_DBACL_VERSION
+        ": error creating shared Bloom filter: %s", strerror(errno));
+    }
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLSharedCache", FALSE);
+  if (c == NULL ||
+      *((int *) c->argv[0]) == FALSE) {
+    return;
+  }
+
+  dbacl_shm_ttl = *((unsigned int *) c->argv[2]);
+
+  if (dbacl_shm_create(*((unsigned int *) c->argv[1])) < 0) {
+    pr_log_pri(PR_LOG_NOTICE, MOD_DBACL_VERSION
+      ": error creating shared cache: %s", strerror(errno));
+    return;
+  }
+
+  pr_log_debug(DEBUG2, MOD_DBACL_VERSION
+    ": created shared cache of %u entries (%lu bytes)", dbacl_shm_nslots,
+    (unsigned long) dbacl_shm_size);
+}
+
+static void dbacl_restart_ev(const void *event_data, void *user_data) {
+  /* The shared cache and Bloom filter are recreated, per the new config,
+   * once the config has been parsed again.  Sessions already running keep
+   * their existing mappings.
+   */
+  dbacl_shm_destroy();
+  dbacl_bloom_shm_destroy();
+}
+
+/* Initialization functions
+ */
+
+static int dbacl_init(void) {
+  pr_event_register(&dbacl_module, "core.postparse", dbacl_postparse_ev, NULL);
+  pr_event_register(&dbacl_module, "core.restart", dbacl_restart_ev, NULL);
+
+  return 0;
+}
+
+static int dbacl_sess_init(void) {
+  config_rec *c;
+
+  pr_event_register(&dbacl_module, "core.exit", dbacl_exit_ev, NULL);
+
+  /* The snapshot, and any DBACLBackend file, are opened now, before the
+   * session is chrooted.
+   */
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLSnapshot", FALSE);
+  if (c != NULL &&
+      find_config(main_server->conf, CONF_PARAM, "DBACLWhereClause",
+        FALSE) != NULL) {
+    /* A snapshot holds the same rows for every session, so it cannot honor
+     * a clause selecting rows per user or group.
+     */
+    pr_log_pri(PR_LOG_NOTICE, MOD_DBACL_VERSION
+      ": DBACLSnapshot cannot be used with DBACLWhereClause, ignoring "
+      "DBACLSnapshot '%s'", (const char *) c->argv[0]);
+
+  } else if (c != NULL) {
+    const char *path;
+
+    path = c->argv[0];
+    if (dbacl_snapshot_open(session.pool, path) < 0) {
+      pr_log_pri(PR_LOG_NOTICE, MOD_DBACL_VERSION
+        ": error opening DBACLSnapshot '%s': %s", path, strerror(errno));
+    }
+  }
+
+  c = find_config(main_server->conf, CONF_PARAM, "DBACLBackend", FALSE);
+  if (c != NULL &&
+      *((int *) c->argv[0]) == DBACL_BACKEND_FILE) {
+    const char *path;
+
+    dbacl_backend = DBACL_BACKEND_FILE;
+
+    /* Its rows are loaded once the DBACLSchema column names are known. */
+    path = c->argv[1];
+    if (dbacl_file_open(session.pool, path) < 0) {
+      pr_log_pri(PR_LOG_NOTICE, MOD_DBACL_VERSION
+        ": error opening DBACLBackend file '%s': %s", path, strerror(errno));
+    }
+  }
+
+  return 0;
+}
+
 /* Module API tables
  */
 
 static conftable dbacl_conftab[] = {
+  { "DBACLBackend",	set_dbaclbackend,	NULL },
+  { "DBACLBloomFilter",	set_dbaclbloomfilter,	NULL },
+  { "DBACLCache",	set_dbaclcache,		NULL },
+  { "DBACLCheckIndexes", set_dbaclcheckindexes, NULL },
+  { "DBACLCircuitBreaker", set_dbaclcircuitbreaker, NULL },
+  { "DBACLCommandMap",	set_dbaclcommandmap,	NULL },
   { "DBACLEngine",	set_dbaclengine,	NULL },
+  { "DBACLGeneration",	set_dbaclgeneration,	NULL },
+  { "DBACLOptions",	set_dbacloptions,	NULL },
+  { "DBACLPatterns",	set_dbaclpatterns,	NULL },
   { "DBACLPolicy",	set_dbaclpolicy,	NULL },
+  { "DBACLPrefetch",	set_dbaclprefetch,	NULL },
+  { "DBACLPreload",	set_dbaclpreload,	NULL },
+  { "DBACLQueryStrategy",	set_dbaclquerystrategy,	NULL },
+  { "DBACLRedis",	set_dbaclredis,		NULL },
   { "DBACLSchema",	set_dbaclschema,	NULL },
+  { "DBACLSharedCache",	set_dbaclsharedcache,	NULL },
+  { "DBACLSnapshot",	set_dbaclsnapshot,	NULL },
+  { "DBACLTimeout",	set_dbacltimeout,	NULL },
   { "DBACLWhereClause",	set_dbaclwhereclause,	NULL },
 
   { NULL }
 };
 
 static cmdtable dbacl_cmdtab[] = {
-  { PRE_CMD,	C_APPE,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,    C_CDUP, G_NONE, dbacl_pre_cmd,          TRUE,   FALSE },
-  { PRE_CMD,    C_XCUP, G_NONE, dbacl_pre_cmd,          TRUE,   FALSE },
-  { PRE_CMD,    C_CWD,  G_NONE, dbacl_pre_cmd,          TRUE,   FALSE },
-  { PRE_CMD,    C_XCWD, G_NONE, dbacl_pre_cmd,          TRUE,   FALSE },
-  { PRE_CMD,	C_DELE,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_LIST,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_MDTM,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_MFF,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_MFMT,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_MKD,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_XMKD,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_MLSD,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_MLST,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_NLST,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_PWD,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_XPWD,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_RETR,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_RMD,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_XRMD,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_RNFR,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_RNTO,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_SITE,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_SIZE,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_STAT,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_STOR,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-  { PRE_CMD,	C_STOU,	G_NONE,	dbacl_pre_cmd,		TRUE,	FALSE },
-
-  /* SFTP requests */
-  { PRE_CMD,	"FSETSTAT",	G_NONE,	dbacl_pre_cmd,	TRUE,	FALSE },
-  { PRE_CMD,	"LINK",		G_NONE,	dbacl_pre_cmd,	TRUE,	FALSE },
-  { PRE_CMD,	"LSTAT",	G_NONE,	dbacl_pre_cmd,	TRUE,	FALSE },
-  { PRE_CMD,	"OPENDIR",	G_NONE,	dbacl_pre_cmd,	TRUE,	FALSE },
-  { PRE_CMD,	"READLINK",	G_NONE,	dbacl_pre_cmd,	TRUE,	FALSE },
-  { PRE_CMD,	"REALPATH",	G_NONE,	dbacl_pre_cmd,	TRUE,	FALSE },
-  { PRE_CMD,	"SETSTAT",	G_NONE,	dbacl_pre_cmd,	TRUE,	FALSE },
-  { PRE_CMD,	"SYMLINK",	G_NONE,	dbacl_pre_cmd,	TRUE,	FALSE },
-
-  /* XXX Need to handle SITE CPFR, SITE CPTO, SFTP COPY */
+  /* Every command (and SFTP request) is looked up in the command map; see
+   * DBACLCommandMap.
+   */
+  { PRE_CMD,	C_ANY,	G_NONE,	dbacl_pre_cmd,		FALSE,	FALSE },
+
+  { CMD,	C_SITE,	G_NONE,	dbacl_site,	TRUE,	FALSE,	CL_MISC },
 
   { POST_CMD,	C_PASS,	G_NONE,	dbacl_post_pass,	FALSE,	FALSE },
+  { POST_CMD,	C_ANY,	G_NONE,	dbacl_post_cmd,		FALSE,	FALSE },
+  { POST_CMD_ERR,	C_ANY,	G_NONE,	dbacl_post_cmd,		FALSE,	FALSE },
+
+  { LOG_CMD,	C_APPE,	G_NONE,	dbacl_log_xfer,		FALSE,	FALSE },
+  { LOG_CMD,	C_RETR,	G_NONE,	dbacl_log_xfer,		FALSE,	FALSE },
+  { LOG_CMD,	C_STOR,	G_NONE,	dbacl_log_xfer,		FALSE,	FALSE },
+  { LOG_CMD_ERR,	C_APPE,	G_NONE,	dbacl_log_xfer,		FALSE,	FALSE },
+  { LOG_CMD_ERR,	C_RETR,	G_NONE,	dbacl_log_xfer,		FALSE,	FALSE },
+  { LOG_CMD_ERR,	C_STOR,	G_NONE,	dbacl_log_xfer,		FALSE,	FALSE },
 
   { 0, NULL }
 };
@@ -1113,10 +7443,10 @@ module dbacl_module = {
   NULL,
 
   /* Module initialization function */
-  NULL,
+  dbacl_init,
 
   /* Session initialization function */
-  NULL,
+  dbacl_sess_init,
 
   /* Module version */
   MOD_DBACL_VERSION
@@ -0,0 +1,1024 @@
+/*
+ * ProFTPD: mod_dbacl benchmark -- latency of ACL lookups
+ * Copyright (c) 2025 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+ *
+ * The benchmark compiles in mod_dbacl.c itself, and drives its PRE_CMD
+ * handler directly with synthetic commands.  The mod_sql hooks used by
+ * mod_dbacl are provided by the benchmark, backed by a SQLite database of
+ * synthetic ACL rows, with an optional injected latency per query.
+ *
+ * Each scenario (table size, path depth, command mix) runs in its own
+ * forked process, just as each ProFTPD session does, so that the state
+ * of one scenario (e.g. its cache) does not affect the next.
+ */
+
+#include "mod_dbacl.c"
+
+#include <getopt.h>
+#include <sys/wait.h>
+
+#include <sqlite3.h>
+
+#define BENCH_DEFAULT_NLOOKUPS		10000
+#define BENCH_DEFAULT_ROWS		"100,10000,100000"
+#define BENCH_DEFAULT_DEPTHS		"2,8,32"
+#define BENCH_DEFAULT_MIXES		"retr,mixed,nav"
+
+/* Rows are generated for paths of up to this many components, with this
+ * many distinct names for each component.
+ */
+#define BENCH_ROW_MAX_DEPTH		8
+#define BENCH_ROW_FANOUT		10
+
+#define BENCH_MAX_CONFIG		32
+
+/* What mod_sql substitutes for the variables it does not know. */
+#define BENCH_UNKNOWN_TAG		"{UNKNOWN TAG}"
+
+static const char *program = "dbacl-bench";
+
+static const char *bench_db_path = NULL;
+static sqlite3 *bench_db = NULL;
+static unsigned int bench_latency_us = 0;
+static unsigned long bench_nqueries = 0;
+
+static unsigned int bench_nlookups = BENCH_DEFAULT_NLOOKUPS;
+static unsigned int bench_seed = 1;
+
+static const char *bench_config[BENCH_MAX_CONFIG];
+static unsigned int bench_nconfig = 0;
+
+/* The paths of the generated rows, for deriving the looked-up paths. */
+static char **bench_row_paths = NULL;
+static unsigned int *bench_row_depths = NULL;
+static unsigned int bench_nrows = 0;
+
+/* Command mixes */
+struct bench_cmd {
+  const char *name;
+  unsigned int weight;
+
+  /* TRUE if the command operates on a directory, rather than a file. */
+  int dir;
+};
+
+struct bench_mix {
+  const char *name;
+  struct bench_cmd cmds[8];
+
+  /* TRUE if the file commands operate on the entries of the most recently
+   * listed directory, as a synchronization tool's would.
+   */
+  int entries;
+};
+
+static struct bench_mix bench_mixes[] = {
+  { "retr", {
+      { C_RETR, 100, FALSE },
+      { NULL } } },
+
+  { "mixed", {
+      { C_RETR, 40, FALSE },
+      { C_STOR, 15, FALSE },
+      { C_SIZE, 10, FALSE },
+      { C_MDTM, 5, FALSE },
+      { C_DELE, 5, FALSE },
+      { C_CWD, 10, TRUE },
+      { C_LIST, 10, TRUE },
+      { C_MKD, 5, TRUE } } },
+
+  { "nav", {
+      { C_CWD, 40, TRUE },
+      { C_LIST, 30, TRUE },
+      { C_MLSD, 15, TRUE },
+      { C_SIZE, 15, FALSE },
+      { NULL } } },
+
+  { "sync", {
+      { C_MLSD, 5, TRUE },
+      { C_MDTM, 30, FALSE },
+      { C_SIZE, 30, FALSE },
+      { C_RETR, 35, FALSE },
+      { NULL } }, TRUE },
+
+  /* Each RNTO is preceded by an RNFR of another path; see bench_run(). */
+  { "rename", {
+      { C_RNTO, 100, FALSE },
+      { NULL } } },
+
+  { NULL }
+};
+
+/* Results of a scenario */
+struct bench_result {
+  double p50_us, p99_us, max_us, mean_us;
+  double queries_per_lookup;
+  double allocs_per_lookup;
+  double bytes_per_lookup;
+  unsigned int ndenied;
+};
+
+/* mod_sql hooks
+ */
+
+/* Resolves the variables in a named query, as mod_sql does: '%' followed by
+ * any character is a variable.  Only %u and %g are known here; as with the
+ * variables mod_sql does not know, any other is replaced by "{UNKNOWN TAG}",
+ * so that queries using '%' for anything else fail here as they would with
+ * mod_sql.
+ */
+static char *bench_sql_resolve(pool *p, const char *text) {
+  const char *ptr;
+  char *res, *dst;
+  size_t len;
+
+  len = strlen(text) + 1;
+  for (ptr = text; *ptr != '\0'; ptr++) {
+    if (*ptr == '%') {
+      len += strlen(session.user) + strlen(session.group) +
+        strlen(BENCH_UNKNOWN_TAG);
+    }
+  }
+
+  res = dst = palloc(p, len);
+
+  for (ptr = text; *ptr != '\0'; ptr++) {
+    const char *var;
+    size_t varlen;
+
+    if (*ptr != '%') {
+      *dst++ = *ptr;
+      continue;
+    }
+
+    ptr++;
+    if (*ptr == 'u') {
+      var = session.user;
+
+    } else if (*ptr == 'g') {
+      var = session.group;
+
+    } else {
+      var = BENCH_UNKNOWN_TAG;
+    }
+
+    varlen = strlen(var);
+    memcpy(dst, var, varlen);
+    dst += varlen;
+
+    if (*ptr == '\0') {
+      break;
+    }
+  }
+
+  *dst = '\0';
+  return res;
+}
+
+MODRET bench_sql_lookup(cmd_rec *cmd) {
+  config_rec *c;
+  char *query_name, *query;
+  sqlite3_stmt *stmt;
+  array_header *sql_data;
+  unsigned long nallocs, nbytes;
+  int res;
+
+  /* Allocations made by this stand-in for mod_sql are not counted. */
+  nallocs = bench_pool_nallocs;
+  nbytes = bench_pool_nbytes;
+
+  query_name = pstrcat(cmd->tmp_pool, "SQLNamedQuery_", cmd->argv[1], NULL);
+  c = find_config(main_server->conf, CONF_PARAM, query_name, FALSE);
+  if (c == NULL) {
+    fprintf(stderr, "%s: unknown SQLNamedQuery '%s'\n", program,
+      (char *) cmd->argv[1]);
+    return PR_ERROR(cmd);
+  }
+
+  query = bench_sql_resolve(cmd->tmp_pool, c->argv[1]);
+  if (strcasecmp(c->argv[0], "SELECT") == 0) {
+    query = pstrcat(cmd->tmp_pool, "SELECT ", query, NULL);
+  }
+
+  if (bench_latency_us > 0) {
+    struct timespec ts;
+
+    ts.tv_sec = bench_latency_us / 1000000;
+    ts.tv_nsec = (bench_latency_us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) < 0 &&
+           errno == EINTR);
+  }
+
+  bench_nqueries++;
+
+  res = sqlite3_prepare_v2(bench_db, query, -1, &stmt, NULL);
+  if (res != SQLITE_OK) {
+    fprintf(stderr, "%s: error preparing query '%s': %s\n", program, query,
+      sqlite3_errmsg(bench_db));
+    return PR_ERROR(cmd);
+  }
+
+  sql_data = make_array(cmd->tmp_pool, 1, sizeof(char *));
+
+  while ((res = sqlite3_step(stmt)) == SQLITE_ROW) {
+    register int i;
+    int ncols;
+
+    ncols = sqlite3_column_count(stmt);
+    for (i = 0; i < ncols; i++) {
+      const char *value;
+
+      /* mod_sql's backends report NULL values as "NULL". */
+      value = (const char *) sqlite3_column_text(stmt, i);
+      *((char **) push_array(sql_data)) = pstrdup(cmd->tmp_pool,
+        value != NULL ? value : "NULL");
+    }
+  }
+
+  sqlite3_finalize(stmt);
+
+  if (res != SQLITE_DONE) {
+    fprintf(stderr, "%s: error running query '%s': %s\n", program, query,
+      sqlite3_errmsg(bench_db));
+    return PR_ERROR(cmd);
+  }
+
+  bench_pool_nallocs = nallocs;
+  bench_pool_nbytes = nbytes;
+
+  return mod_create_data(cmd, sql_data);
+}
+
+MODRET bench_sql_escapestr(cmd_rec *cmd) {
+  const char *ptr;
+  char *res, *dst;
+  unsigned long nallocs, nbytes;
+
+  nallocs = bench_pool_nallocs;
+  nbytes = bench_pool_nbytes;
+
+  /* Double any single quotes, as mod_sql_sqlite does. */
+  res = dst = palloc(cmd->tmp_pool, (strlen(cmd->argv[0]) * 2) + 1);
+  for (ptr = cmd->argv[0]; *ptr != '\0'; ptr++) {
+    if (*ptr == '\'') {
+      *dst++ = '\'';
+    }
+
+    *dst++ = *ptr;
+  }
+  *dst = '\0';
+
+  bench_pool_nallocs = nallocs;
+  bench_pool_nbytes = nbytes;
+
+  return mod_create_data(cmd, res);
+}
+
+static cmdtable bench_sql_hooks[] = {
+  { HOOK,	"sql_lookup",		G_NONE, bench_sql_lookup,	FALSE, FALSE },
+  { HOOK,	"sql_escapestr",	G_NONE, bench_sql_escapestr,	FALSE, FALSE },
+
+  { 0, NULL }
+};
+
+/* Configuration
+ */
+
+/* Splits a configuration line into words, honoring double quotes, and
+ * calls mod_dbacl's handler for the directive.
+ */
+static int bench_config_line(pool *p, const char *line) {
+  register unsigned int i;
+  cmd_rec *cmd;
+  conftable *conftab;
+  modret_t *mr;
+  char *ptr, *words[32];
+  unsigned int nwords = 0;
+
+  ptr = pstrdup(p, line);
+
+  while (*ptr != '\0' &&
+         nwords < 32) {
+    char *word;
+
+    while (isspace((int) *ptr)) {
+      ptr++;
+    }
+
+    if (*ptr == '\0') {
+      break;
+    }
+
+    if (*ptr == '"') {
+      word = ++ptr;
+      while (*ptr != '\0' &&
+             *ptr != '"') {
+        ptr++;
+      }
+
+    } else {
+      word = ptr;
+      while (*ptr != '\0' &&
+             !isspace((int) *ptr)) {
+        ptr++;
+      }
+    }
+
+    if (*ptr != '\0') {
+      *ptr++ = '\0';
+    }
+
+    words[nwords++] = word;
+  }
+
+  if (nwords == 0) {
+    return 0;
+  }
+
+  for (conftab = dbacl_module.conftable; conftab->directive; conftab++) {
+    if (strcasecmp(conftab->directive, words[0]) == 0) {
+      break;
+    }
+  }
+
+  if (conftab->directive == NULL) {
+    fprintf(stderr, "%s: unknown directive '%s'\n", program, words[0]);
+    return -1;
+  }
+
+  cmd = pcalloc(p, sizeof(cmd_rec));
+  cmd->pool = cmd->tmp_pool = p;
+  cmd->server = main_server;
+  cmd->argc = nwords;
+  cmd->argv = pcalloc(p, (nwords + 1) * sizeof(char *));
+
+  cmd->argv[0] = (char *) conftab->directive;
+  for (i = 1; i < nwords; i++) {
+    cmd->argv[i] = words[i];
+  }
+
+  mr = conftab->handler(cmd);
+  if (MODRET_ISERROR(mr)) {
+    fprintf(stderr, "%s: %s\n", program, mr->mr_message);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Synthetic ACL table
+ */
+
+static const char *bench_acl_value(unsigned int *seed) {
+  unsigned int n;
+
+  n = rand_r(seed) % 10;
+  if (n < 7) {
+    return "allow";
+  }
+
+  if (n < 8) {
+    return "deny";
+  }
+
+  return NULL;
+}
+
+static int bench_db_create(pool *p, unsigned int nrows) {
+  register unsigned int i;
+  char *errmsg = NULL;
+  sqlite3_stmt *stmt;
+  unsigned int seed;
+
+  if (sqlite3_open(bench_db_path, &bench_db) != SQLITE_OK) {
+    fprintf(stderr, "%s: error opening '%s': %s\n", program, bench_db_path,
+      sqlite3_errmsg(bench_db));
+    return -1;
+  }
+
+  if (sqlite3_exec(bench_db,
+      "DROP TABLE IF EXISTS ftpacl;"
+      "CREATE TABLE ftpacl ("
+      "  path TEXT NOT NULL,"
+      "  read_acl TEXT,"
+      "  write_acl TEXT,"
+      "  delete_acl TEXT,"
+      "  create_acl TEXT,"
+      "  modify_acl TEXT,"
+      "  move_acl TEXT,"
+      "  view_acl TEXT,"
+      "  navigate_acl TEXT,"
+      "  acls INTEGER NOT NULL DEFAULT 0,"
+      "  owner TEXT NOT NULL DEFAULT 'bench'"
+      ");"
+      "CREATE UNIQUE INDEX ftpacl_path_idx ON ftpacl (path);"
+      "BEGIN;", NULL, NULL, &errmsg) != SQLITE_OK) {
+    fprintf(stderr, "%s: error creating table: %s\n", program, errmsg);
+    sqlite3_free(errmsg);
+    return -1;
+  }
+
+  if (sqlite3_prepare_v2(bench_db,
+      "INSERT INTO ftpacl (path, read_acl, write_acl, delete_acl, create_acl, "
+      "modify_acl, move_acl, view_acl, navigate_acl, acls) "
+      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", -1, &stmt, NULL) != SQLITE_OK) {
+    fprintf(stderr, "%s: error preparing insert: %s\n", program,
+      sqlite3_errmsg(bench_db));
+    return -1;
+  }
+
+  bench_row_paths = palloc(p, nrows * sizeof(char *));
+  bench_row_depths = palloc(p, nrows * sizeof(unsigned int));
+  bench_nrows = nrows;
+
+  seed = bench_seed;
+
+  for (i = 0; i < nrows; i++) {
+    register unsigned int j;
+    char *path = "";
+    unsigned int depth, packed = 0;
+    int res;
+
+    /* There is always a row for the root directory. */
+    depth = (i == 0) ? 0 : (rand_r(&seed) % BENCH_ROW_MAX_DEPTH) + 1;
+
+    for (j = 0; j < depth; j++) {
+      char name[32];
+
+      snprintf(name, sizeof(name), "/d%u", rand_r(&seed) % BENCH_ROW_FANOUT);
+      path = pstrcat(p, path, name, NULL);
+    }
+
+    if (depth == 0) {
+      path = "/";
+    }
+
+    bench_row_paths[i] = path;
+    bench_row_depths[i] = depth;
+
+    sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+    for (j = 0; j < DBACL_ACL_COUNT; j++) {
+      const char *value;
+
+      value = bench_acl_value(&seed);
+      if (value != NULL) {
+        sqlite3_bind_text(stmt, j + 2, value, -1, SQLITE_STATIC);
+        packed |= (strcmp(value, "deny") == 0 ? DBACL_VALUE_DENY :
+          DBACL_VALUE_ALLOW) << (j * DBACL_PACKED_BITS);
+
+      } else {
+        sqlite3_bind_null(stmt, j + 2);
+      }
+    }
+
+    /* The same values, for "DBACLSchema ftpacl path acls". */
+    sqlite3_bind_int(stmt, DBACL_ACL_COUNT + 2, (int) packed);
+
+    res = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+
+    if (res == SQLITE_CONSTRAINT) {
+      /* There is already a row for this path; pick another. */
+      i--;
+      continue;
+    }
+
+    if (res != SQLITE_DONE) {
+      fprintf(stderr, "%s: error inserting row: %s\n", program,
+        sqlite3_errmsg(bench_db));
+      sqlite3_finalize(stmt);
+      return -1;
+    }
+  }
+
+  sqlite3_finalize(stmt);
+
+  if (sqlite3_exec(bench_db, "COMMIT;", NULL, NULL, &errmsg) != SQLITE_OK) {
+    fprintf(stderr, "%s: error populating table: %s\n", program, errmsg);
+    sqlite3_free(errmsg);
+    return -1;
+  }
+
+  /* Each scenario opens its own connection, as each session would. */
+  sqlite3_close(bench_db);
+  bench_db = NULL;
+
+  return 0;
+}
+
+/* Returns a path of the given depth (in directories), under the path of a
+ * random row, so that lookups find rows at various depths.
+ */
+static char *bench_get_path(pool *p, unsigned int depth, int dir,
+    unsigned int *seed) {
+  register unsigned int i;
+  const char *row_path = "/";
+  unsigned int row_depth = 0;
+  char *path;
+
+  for (i = 0; i < 8; i++) {
+    unsigned int idx;
+
+    idx = rand_r(seed) % bench_nrows;
+    if (bench_row_depths[idx] <= depth) {
+      row_path = bench_row_paths[idx];
+      row_depth = bench_row_depths[idx];
+      break;
+    }
+  }
+
+  path = row_depth > 0 ? pstrdup(p, row_path) : "";
+
+  for (i = row_depth; i < depth; i++) {
+    char name[32];
+
+    snprintf(name, sizeof(name), "/e%u", rand_r(seed) % BENCH_ROW_FANOUT);
+    path = pstrcat(p, path, name, NULL);
+  }
+
+  if (!dir) {
+    char name[32];
+
+    snprintf(name, sizeof(name), "/f%u.txt", rand_r(seed) % 100);
+    path = pstrcat(p, path, name, NULL);
+  }
+
+  if (*path == '\0') {
+    path = "/";
+  }
+
+  return path;
+}
+
+static const struct bench_cmd *bench_get_cmd(struct bench_mix *mix,
+    unsigned int *seed) {
+  register unsigned int i;
+  unsigned int total = 0, n;
+
+  for (i = 0; i < 8 && mix->cmds[i].name != NULL; i++) {
+    total += mix->cmds[i].weight;
+  }
+
+  n = rand_r(seed) % total;
+  for (i = 0; i < 8 && mix->cmds[i].name != NULL; i++) {
+    if (n < mix->cmds[i].weight) {
+      break;
+    }
+
+    n -= mix->cmds[i].weight;
+  }
+
+  return &(mix->cmds[i]);
+}
+
+/* Scenarios
+ */
+
+static int bench_cmp_ns(const void *a, const void *b) {
+  uint64_t x, y;
+
+  x = *((const uint64_t *) a);
+  y = *((const uint64_t *) b);
+
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static uint64_t bench_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/* Runs a scenario, as a session would: the session is set up, as after a
+ * successful login, and then each command is checked in turn.
+ */
+static int bench_run(struct bench_mix *mix, unsigned int depth,
+    struct bench_result *result) {
+  register unsigned int i;
+  pool *p;
+  cmd_rec *cmd;
+  char **paths, **src_paths, *dir_path = NULL;
+  const struct bench_cmd **cmds;
+  uint64_t *elapsed, total_ns = 0;
+  unsigned long nallocs = 0, nbytes = 0;
+  unsigned int seed;
+
+  if (sqlite3_open_v2(bench_db_path, &bench_db, SQLITE_OPEN_READONLY,
+      NULL) != SQLITE_OK) {
+    fprintf(stderr, "%s: error opening '%s': %s\n", program, bench_db_path,
+      sqlite3_errmsg(bench_db));
+    return -1;
+  }
+
+  session.pool = make_sub_pool(permanent_pool);
+  session.user = "bench";
+  session.group = "bench";
+
+  if (dbacl_module.sess_init() < 0) {
+    return -1;
+  }
+
+  p = make_sub_pool(session.pool);
+
+  cmd = pcalloc(p, sizeof(cmd_rec));
+  cmd->pool = cmd->tmp_pool = p;
+  cmd->argc = 2;
+  cmd->argv = pcalloc(p, 3 * sizeof(char *));
+  cmd->argv[0] = C_PASS;
+  cmd->argv[1] = "bench";
+  cmd->arg = "bench";
+  (void) dbacl_post_pass(cmd);
+
+  /* Generate the commands up front, so that only the lookups are timed. */
+  seed = bench_seed + depth;
+  paths = palloc(p, bench_nlookups * sizeof(char *));
+  src_paths = pcalloc(p, bench_nlookups * sizeof(char *));
+  cmds = palloc(p, bench_nlookups * sizeof(struct bench_cmd *));
+  elapsed = palloc(p, bench_nlookups * sizeof(uint64_t));
+
+  for (i = 0; i < bench_nlookups; i++) {
+    cmds[i] = bench_get_cmd(mix, &seed);
+
+    if (mix->entries &&
+        !cmds[i]->dir &&
+        dir_path != NULL) {
+      char name[32];
+
+      snprintf(name, sizeof(name), "/f%u.txt", rand_r(&seed) % 100);
+      paths[i] = pstrcat(p, strcmp(dir_path, "/") != 0 ? dir_path : "", name,
+        NULL);
+
+    } else {
+      paths[i] = bench_get_path(p, depth, cmds[i]->dir, &seed);
+
+      if (cmds[i]->dir) {
+        dir_path = paths[i];
+      }
+    }
+
+    if (strcmp(cmds[i]->name, C_RNTO) == 0) {
+      src_paths[i] = bench_get_path(p, depth, cmds[i]->dir, &seed);
+    }
+  }
+
+  memset(result, 0, sizeof(struct bench_result));
+  bench_nqueries = 0;
+
+  for (i = 0; i < bench_nlookups; i++) {
+    pool *cmd_pool;
+    modret_t *mr;
+    unsigned long nallocs_start, nbytes_start;
+    uint64_t start_ns;
+
+    cmd_pool = make_sub_pool(session.pool);
+
+    cmd = pcalloc(cmd_pool, sizeof(cmd_rec));
+    cmd->pool = cmd->tmp_pool = cmd_pool;
+    cmd->argc = 2;
+    cmd->argv = pcalloc(cmd_pool, 3 * sizeof(char *));
+    cmd->argv[0] = (char *) cmds[i]->name;
+    cmd->argv[1] = paths[i];
+    cmd->arg = paths[i];
+    cmd->cmd_id = pr_cmd_get_id(cmds[i]->name);
+
+    /* The path given to the preceding RNFR, as the core records it. */
+    session.xfer.path = src_paths[i];
+
+    nallocs_start = bench_pool_nallocs;
+    nbytes_start = bench_pool_nbytes;
+    start_ns = bench_now_ns();
+
+    mr = dbacl_pre_cmd(cmd);
+
+    elapsed[i] = bench_now_ns() - start_ns;
+    nallocs += bench_pool_nallocs - nallocs_start;
+    nbytes += bench_pool_nbytes - nbytes_start;
+    total_ns += elapsed[i];
+
+    if (MODRET_ISERROR(mr)) {
+      result->ndenied++;
+    }
+
+    destroy_pool(cmd_pool);
+  }
+
+  qsort(elapsed, bench_nlookups, sizeof(uint64_t), bench_cmp_ns);
+
+  result->p50_us = elapsed[(bench_nlookups * 50) / 100] / 1000.0;
+  result->p99_us = elapsed[(bench_nlookups * 99) / 100] / 1000.0;
+  result->max_us = elapsed[bench_nlookups - 1] / 1000.0;
+  result->mean_us = (total_ns / (double) bench_nlookups) / 1000.0;
+  result->queries_per_lookup = bench_nqueries / (double) bench_nlookups;
+  result->allocs_per_lookup = nallocs / (double) bench_nlookups;
+  result->bytes_per_lookup = nbytes / (double) bench_nlookups;
+
+  sqlite3_close(bench_db);
+  bench_db = NULL;
+
+  return 0;
+}
+
+/* Runs a scenario in a child process, which reports its results over a
+ * pipe.
+ */
+static int bench_fork_run(struct bench_mix *mix, unsigned int depth,
+    struct bench_result *result) {
+  int fds[2], status;
+  pid_t pid;
+  ssize_t len;
+
+  if (pipe(fds) < 0) {
+    fprintf(stderr, "%s: error creating pipe: %s\n", program,
+      strerror(errno));
+    return -1;
+  }
+
+  fflush(stdout);
+
+  pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "%s: error forking: %s\n", program, strerror(errno));
+    return -1;
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+
+    if (bench_run(mix, depth, result) < 0) {
+      _exit(1);
+    }
+
+    if (write(fds[1], result, sizeof(struct bench_result)) !=
+        sizeof(struct bench_result)) {
+      _exit(1);
+    }
+
+    _exit(0);
+  }
+
+  close(fds[1]);
+  len = read(fds[0], result, sizeof(struct bench_result));
+  close(fds[0]);
+
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      break;
+    }
+  }
+
+  if (len != sizeof(struct bench_result)) {
+    fprintf(stderr, "%s: scenario failed\n", program);
+    return -1;
+  }
+
+  return 0;
+}
+
+static unsigned int bench_parse_list(pool *p, const char *str,
+    char ***items) {
+  char *buf, *ptr, *item;
+  unsigned int nitems = 0;
+
+  buf = pstrdup(p, str);
+  *items = pcalloc(p, (strlen(str) + 1) * sizeof(char *));
+
+  for (ptr = buf; (item = strtok(ptr, ",")) != NULL; ptr = NULL) {
+    (*items)[nitems++] = item;
+  }
+
+  return nitems;
+}
+
+static void usage(int exit_code) {
+  fprintf(stdout, "\nusage: %s [options]\n\n", program);
+  fprintf(stdout, "  Measures the latency of mod_dbacl ACL lookups, using "
+    "synthetic ACL tables\n  and commands.\n\n");
+  fprintf(stdout, "  -c directive  mod_dbacl configuration, e.g. "
+    "\"DBACLCache on\"; may be\n                repeated\n");
+  fprintf(stdout, "  -d depths     Comma-separated path depths "
+    "(default: %s)\n", BENCH_DEFAULT_DEPTHS);
+  fprintf(stdout, "  -f file       SQLite database file to use "
+    "(default: a temporary file)\n");
+  fprintf(stdout, "  -h            Displays this message\n");
+  fprintf(stdout, "  -l usecs      Latency to inject into each SQL query "
+    "(default: 0)\n");
+  fprintf(stdout, "  -m mixes      Comma-separated command mixes: retr, "
+    "mixed, nav,\n                sync, rename (default: %s)\n", BENCH_DEFAULT_MIXES);
+  fprintf(stdout, "  -n count      Lookups per scenario (default: %u)\n",
+    BENCH_DEFAULT_NLOOKUPS);
+  fprintf(stdout, "  -r counts     Comma-separated ACL table sizes "
+    "(default: %s)\n", BENCH_DEFAULT_ROWS);
+  fprintf(stdout, "  -s seed       Random seed (default: 1)\n\n");
+
+  exit(exit_code);
+}
+
+int main(int argc, char *argv[]) {
+  register unsigned int i, j, k;
+  const char *rows_str = BENCH_DEFAULT_ROWS;
+  const char *depths_str = BENCH_DEFAULT_DEPTHS;
+  const char *mixes_str = BENCH_DEFAULT_MIXES;
+  char **rows, **depths, **mixes, tmp_path[PATH_MAX];
+  unsigned int nrows, ndepths, nmixes;
+  int opt, tmp_db = FALSE;
+  pool *p;
+
+  while ((opt = getopt(argc, argv, "c:d:f:hl:m:n:r:s:")) != -1) {
+    switch (opt) {
+      case 'c':
+        if (bench_nconfig == BENCH_MAX_CONFIG) {
+          fprintf(stderr, "%s: too many -c options\n", program);
+          return 1;
+        }
+
+        bench_config[bench_nconfig++] = optarg;
+        break;
+
+      case 'd':
+        depths_str = optarg;
+        break;
+
+      case 'f':
+        bench_db_path = optarg;
+        break;
+
+      case 'h':
+        usage(0);
+        break;
+
+      case 'l':
+        bench_latency_us = (unsigned int) strtoul(optarg, NULL, 10);
+        break;
+
+      case 'm':
+        mixes_str = optarg;
+        break;
+
+      case 'n':
+        bench_nlookups = (unsigned int) strtoul(optarg, NULL, 10);
+        if (bench_nlookups == 0) {
+          fprintf(stderr, "%s: -n must be greater than zero\n", program);
+          return 1;
+        }
+        break;
+
+      case 'r':
+        rows_str = optarg;
+        break;
+
+      case 's':
+        bench_seed = (unsigned int) strtoul(optarg, NULL, 10);
+        break;
+
+      default:
+        usage(1);
+    }
+  }
+
+  permanent_pool = make_sub_pool(NULL);
+
+  main_server = pcalloc(permanent_pool, sizeof(server_rec));
+  main_server->pool = permanent_pool;
+  main_server->ServerName = program;
+
+  p = make_sub_pool(permanent_pool);
+
+  for (i = 0; bench_sql_hooks[i].command != NULL; i++) {
+    pr_stash_add_symbol(PR_SYM_HOOK, &(bench_sql_hooks[i]));
+  }
+
+  dbacl_module.init();
+
+  if (bench_config_line(p, "DBACLEngine on") < 0) {
+    return 1;
+  }
+
+  for (i = 0; i < bench_nconfig; i++) {
+    if (bench_config_line(p, bench_config[i]) < 0) {
+      return 1;
+    }
+  }
+
+  pr_event_generate("core.postparse", NULL);
+
+  nrows = bench_parse_list(p, rows_str, &rows);
+  ndepths = bench_parse_list(p, depths_str, &depths);
+  nmixes = bench_parse_list(p, mixes_str, &mixes);
+
+  for (i = 0; i < nmixes; i++) {
+    for (j = 0; bench_mixes[j].name != NULL; j++) {
+      if (strcmp(bench_mixes[j].name, mixes[i]) == 0) {
+        break;
+      }
+    }
+
+    if (bench_mixes[j].name == NULL) {
+      fprintf(stderr, "%s: unknown command mix '%s'\n", program, mixes[i]);
+      return 1;
+    }
+  }
+
+  if (bench_db_path == NULL) {
+    int fd;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s/dbacl-bench.XXXXXX",
+      getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+    fd = mkstemp(tmp_path);
+    if (fd < 0) {
+      fprintf(stderr, "%s: error creating '%s': %s\n", program, tmp_path,
+        strerror(errno));
+      return 1;
+    }
+
+    close(fd);
+    bench_db_path = tmp_path;
+    tmp_db = TRUE;
+  }
+
+  fprintf(stdout, "# %u lookups per scenario, %u usecs injected SQL "
+    "latency\n", bench_nlookups, bench_latency_us);
+  for (i = 0; i < bench_nconfig; i++) {
+    fprintf(stdout, "# %s\n", bench_config[i]);
+  }
+
+  fprintf(stdout, "%8s %5s %-6s %9s %9s %9s %9s %9s %9s %9s %7s\n", "rows",
+    "depth", "mix", "p50(us)", "p99(us)", "max(us)", "mean(us)", "queries",
+    "allocs", "bytes", "denied");
+
+  for (i = 0; i < nrows; i++) {
+    unsigned int table_size;
+    pool *table_pool;
+
+    table_size = (unsigned int) strtoul(rows[i], NULL, 10);
+    if (table_size == 0) {
+      fprintf(stderr, "%s: table size must be greater than zero\n", program);
+      return 1;
+    }
+
+    table_pool = make_sub_pool(p);
+    if (bench_db_create(table_pool, table_size) < 0) {
+      return 1;
+    }
+
+    /* A new table is as if the daemon were restarted for it; the rows in
+     * the shared cache and Bloom filter are of the previous table.
+     */
+    if (i > 0) {
+      pr_event_generate("core.restart", NULL);
+      pr_event_generate("core.postparse", NULL);
+    }
+
+    for (j = 0; j < ndepths; j++) {
+      unsigned int depth;
+
+      depth = (unsigned int) strtoul(depths[j], NULL, 10);
+
+      for (k = 0; k < nmixes; k++) {
+        register unsigned int m;
+        struct bench_result result;
+
+        for (m = 0; bench_mixes[m].name != NULL; m++) {
+          if (strcmp(bench_mixes[m].name, mixes[k]) == 0) {
+            break;
+          }
+        }
+
+        if (bench_fork_run(&(bench_mixes[m]), depth, &result) < 0) {
+          return 1;
+        }
+
+        fprintf(stdout,
+          "%8u %5u %-6s %9.1f %9.1f %9.1f %9.1f %9.2f %9.1f %9.0f %7u\n",
+          table_size, depth, mixes[k], result.p50_us, result.p99_us,
+          result.max_us, result.mean_us, result.queries_per_lookup,
+          result.allocs_per_lookup, result.bytes_per_lookup, result.ndenied);
+      }
+    }
+
+    destroy_pool(table_pool);
+  }
+
+  if (tmp_db) {
+    unlink(bench_db_path);
+  }
+
+  pr_event_generate("core.restart", NULL);
+  destroy_pool(permanent_pool);
+
+  return 0;
+}
@@ -0,0 +1,406 @@
+/*
+ * ProFTPD: mod_dbacl benchmark -- minimal stand-in for the ProFTPD core API
+ * Copyright (c) 2025 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+ *
+ * This header declares just the parts of the ProFTPD API used by mod_dbacl,
+ * so that mod_dbacl.c can be compiled into the benchmark without a ProFTPD
+ * source tree.  The implementations, in shim.c, are deliberately simple;
+ * pools are the exception, as their allocations are what the benchmark
+ * counts.
+ */
+
+#ifndef DBACL_BENCH_CONF_H
+#define DBACL_BENCH_CONF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <fnmatch.h>
+#include <syslog.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define PROFTPD_VERSION_NUMBER		0x0001030901
+
+#ifndef TRUE
+# define TRUE				1
+#endif
+
+#ifndef FALSE
+# define FALSE				0
+#endif
+
+/* Pools */
+typedef struct pool_rec pool;
+
+extern pool *permanent_pool;
+
+pool *make_sub_pool(pool *);
+void destroy_pool(pool *);
+void pr_pool_tag(pool *, const char *);
+void *palloc(pool *, size_t);
+void *pcalloc(pool *, size_t);
+char *pstrdup(pool *, const char *);
+char *pstrndup(pool *, const char *, size_t);
+char *pstrcat(pool *, ...);
+char *pdircat(pool *, ...);
+
+/* Counts of the allocations made from all pools, for the benchmark. */
+extern unsigned long bench_pool_nallocs;
+extern unsigned long bench_pool_nbytes;
+
+typedef struct {
+  pool *pool;
+  int elt_size;
+  int nelts;
+  int nalloc;
+  void *elts;
+} array_header;
+
+array_header *make_array(pool *, unsigned int, size_t);
+void *push_array(array_header *);
+
+/* Tables */
+typedef struct table_rec pr_table_t;
+
+#define PR_TABLE_CTL_SET_MAX_ENTS	6
+
+pr_table_t *pr_table_alloc(pool *, int);
+pr_table_t *pr_table_nalloc(pool *, int, unsigned int);
+int pr_table_add(pr_table_t *, const char *, const void *, size_t);
+int pr_table_kadd(pr_table_t *, const void *, size_t, const void *, size_t);
+const void *pr_table_get(pr_table_t *, const char *, size_t *);
+const void *pr_table_kget(pr_table_t *, const void *, size_t, size_t *);
+const void *pr_table_remove(pr_table_t *, const char *, size_t *);
+const void *pr_table_kremove(pr_table_t *, const void *, size_t, size_t *);
+int pr_table_count(pr_table_t *);
+int pr_table_ctl(pr_table_t *, int, void *);
+
+/* Configuration */
+typedef struct config_struc config_rec;
+typedef struct xaset_rec xaset_t;
+
+struct xaset_rec {
+  config_rec *head, *tail;
+};
+
+struct config_struc {
+  config_rec *next, *prev;
+  int config_type;
+  pool *pool;
+  char *name;
+  unsigned int argc;
+  void **argv;
+};
+
+typedef struct server_struc {
+  pool *pool;
+  const char *ServerName;
+  unsigned int ServerPort;
+  unsigned int sid;
+  xaset_t *conf;
+} server_rec;
+
+extern server_rec *main_server;
+
+#define CONF_ROOT			(1 << 0)
+#define CONF_DIR			(1 << 1)
+#define CONF_ANON			(1 << 2)
+#define CONF_LIMIT			(1 << 3)
+#define CONF_VIRTUAL			(1 << 4)
+#define CONF_DYNDIR			(1 << 5)
+#define CONF_GLOBAL			(1 << 6)
+#define CONF_CLASS			(1 << 7)
+#define CONF_NAMED			(1 << 8)
+#define CONF_USERDATA			(1 << 14)
+#define CONF_PARAM			(1 << 15)
+
+config_rec *add_config_param(const char *, unsigned int, ...);
+config_rec *add_config_param_str(const char *, unsigned int, ...);
+config_rec *add_config_param_set(xaset_t **, const char *, unsigned int, ...);
+config_rec *find_config(xaset_t *, int, const char *, int);
+config_rec *find_config_next(config_rec *, config_rec *, int, const char *,
+  int);
+
+/* Modules */
+typedef struct module_struc module;
+typedef struct cmd_struc cmd_rec;
+
+typedef struct modret_struc {
+  module *mr_handler_module;
+  int mr_error;
+  char *mr_numeric;
+  char *mr_message;
+  void *data;
+} modret_t;
+
+struct cmd_struc {
+  pool *pool;
+  server_rec *server;
+  config_rec *config;
+  pool *tmp_pool;
+  unsigned int argc;
+  char *arg;
+  void **argv;
+  char *group;
+  int cmd_class;
+  int cmd_id;
+  pr_table_t *notes;
+};
+
+typedef struct {
+  int cmd_type;
+  const char *command;
+  const char *group;
+  modret_t *(*handler)(cmd_rec *);
+  int requires_auth;
+  int interrupt_xfer;
+  int cmd_class;
+  module *m;
+} cmdtable;
+
+typedef struct {
+  const char *directive;
+  modret_t *(*handler)(cmd_rec *);
+  module *m;
+} conftable;
+
+typedef struct {
+  int auth_type;
+  const char *name;
+  modret_t *(*handler)(cmd_rec *);
+  module *m;
+} authtable;
+
+struct module_struc {
+  module *next, *prev;
+  int api_version;
+  const char *name;
+  conftable *conftable;
+  cmdtable *cmdtable;
+  authtable *authtable;
+  int (*init)(void);
+  int (*sess_init)(void);
+  const char *module_version;
+  void *handle;
+  int priority;
+};
+
+#define MODRET				modret_t *
+
+modret_t *mod_create_ret(cmd_rec *, unsigned char, const char *,
+  const char *);
+modret_t *mod_create_data(cmd_rec *, void *);
+modret_t *pr_module_call(module *, modret_t *(*)(cmd_rec *), cmd_rec *);
+module *pr_module_get(const char *);
+
+#define PR_HANDLED(cmd)			mod_create_ret((cmd), 0, NULL, NULL)
+#define PR_DECLINED(cmd)		((modret_t *) NULL)
+#define PR_ERROR(cmd)			mod_create_ret((cmd), 1, NULL, NULL)
+#define PR_ERROR_MSG(cmd, n, m)		mod_create_ret((cmd), 1, (n), (m))
+
+#define MODRET_ISDECLINED(x)		((x) == NULL)
+#define MODRET_ISHANDLED(x)		((x) != NULL && !(x)->mr_error)
+#define MODRET_ISERROR(x)		((x) != NULL && (x)->mr_error)
+
+#define CONF_ERROR(cmd, msg) \
+  return PR_ERROR_MSG((cmd), NULL, pstrcat((cmd)->tmp_pool, \
+    (char *) (cmd)->argv[0], ": ", (msg), NULL))
+
+#define CHECK_ARGS(cmd, n) \
+  if ((cmd)->argc-1 < (n)) \
+    CONF_ERROR((cmd), "missing parameters")
+
+/* All benchmark configuration is in the "server config" context. */
+#define CHECK_CONF(cmd, mask) \
+  if (((mask) & CONF_ROOT) == 0) \
+    CONF_ERROR((cmd), "directive not allowed in context")
+
+int get_boolean(cmd_rec *, int);
+
+typedef enum {
+  PR_SYM_CONF = 1,
+  PR_SYM_CMD,
+  PR_SYM_AUTH,
+  PR_SYM_HOOK
+} pr_stash_type_t;
+
+int pr_stash_add_symbol(pr_stash_type_t, void *);
+void *pr_stash_get_symbol(pr_stash_type_t, const char *, void *, int *);
+
+#define PRE_CMD				1
+#define CMD				2
+#define POST_CMD			3
+#define POST_CMD_ERR			4
+#define LOG_CMD				5
+#define LOG_CMD_ERR			6
+#define HOOK				7
+
+#define G_NONE				NULL
+
+#define CL_MISC				(1 << 9)
+
+/* Commands */
+#define C_ANY				"*"
+#define C_APPE				"APPE"
+#define C_CDUP				"CDUP"
+#define C_CWD				"CWD"
+#define C_DELE				"DELE"
+#define C_LIST				"LIST"
+#define C_MDTM				"MDTM"
+#define C_MFF				"MFF"
+#define C_MFMT				"MFMT"
+#define C_MKD				"MKD"
+#define C_MLSD				"MLSD"
+#define C_MLST				"MLST"
+#define C_NLST				"NLST"
+#define C_PASS				"PASS"
+#define C_PWD				"PWD"
+#define C_RETR				"RETR"
+#define C_RMD				"RMD"
+#define C_RNFR				"RNFR"
+#define C_RNTO				"RNTO"
+#define C_SITE				"SITE"
+#define C_SIZE				"SIZE"
+#define C_STAT				"STAT"
+#define C_STOR				"STOR"
+#define C_STOU				"STOU"
+#define C_XCUP				"XCUP"
+#define C_XCWD				"XCWD"
+#define C_XMKD				"XMKD"
+#define C_XPWD				"XPWD"
+#define C_XRMD				"XRMD"
+
+#define PR_CMD_APPE_ID			1
+#define PR_CMD_CDUP_ID			2
+#define PR_CMD_CWD_ID			3
+#define PR_CMD_DELE_ID			4
+#define PR_CMD_LIST_ID			5
+#define PR_CMD_MDTM_ID			6
+#define PR_CMD_MFF_ID			7
+#define PR_CMD_MFMT_ID			8
+#define PR_CMD_MKD_ID			9
+#define PR_CMD_MLSD_ID			10
+#define PR_CMD_MLST_ID			11
+#define PR_CMD_NLST_ID			12
+#define PR_CMD_PASS_ID			13
+#define PR_CMD_PWD_ID			14
+#define PR_CMD_RETR_ID			15
+#define PR_CMD_RMD_ID			16
+#define PR_CMD_RNFR_ID			17
+#define PR_CMD_RNTO_ID			18
+#define PR_CMD_SITE_ID			19
+#define PR_CMD_SIZE_ID			20
+#define PR_CMD_STAT_ID			21
+#define PR_CMD_STOR_ID			22
+#define PR_CMD_STOU_ID			23
+#define PR_CMD_XCUP_ID			24
+#define PR_CMD_XCWD_ID			25
+#define PR_CMD_XMKD_ID			26
+#define PR_CMD_XPWD_ID			27
+#define PR_CMD_XRMD_ID			28
+
+int pr_cmd_get_id(const char *);
+int pr_cmd_cmp(cmd_rec *, int);
+int pr_cmd_strcmp(cmd_rec *, const char *);
+
+/* Responses */
+#define R_211				"211"
+#define R_450				"450"
+#define R_501				"501"
+#define R_550				"550"
+
+void pr_response_add(const char *, const char *, ...);
+void pr_response_add_err(const char *, const char *, ...);
+
+/* Session */
+typedef struct {
+  pool *pool;
+  const char *user;
+  const char *group;
+  pr_table_t *notes;
+
+  struct {
+    pool *p;
+    char *path;
+  } xfer;
+} session_t;
+
+extern session_t session;
+
+const char *pr_session_get_protocol(int);
+
+/* Filesystem */
+typedef struct fs_rec pr_fs_t;
+
+struct fs_rec {
+  pr_fs_t *fs_next, *fs_prev;
+  char *fs_name;
+  char *fs_path;
+  void *fs_data;
+
+  void *(*opendir)(pr_fs_t *, const char *);
+  int (*closedir)(pr_fs_t *, void *);
+  struct dirent *(*readdir)(pr_fs_t *, void *);
+};
+
+pr_fs_t *pr_register_fs(pool *, const char *, const char *);
+const char *pr_fs_getcwd(void);
+int pr_fs_valid_path(const char *);
+char *dir_abs_path(pool *, const char *, int);
+
+/* Events */
+int pr_event_register(module *, const char *,
+  void (*)(const void *, void *), void *);
+void pr_event_generate(const char *, const void *);
+
+/* Logging */
+#define PR_LOG_WARNING			LOG_WARNING
+#define PR_LOG_NOTICE			LOG_NOTICE
+#define PR_LOG_INFO			LOG_INFO
+#define PR_LOG_DEBUG			LOG_DEBUG
+
+#define DEBUG0				0
+#define DEBUG1				1
+#define DEBUG2				2
+#define DEBUG3				3
+#define DEBUG4				4
+#define DEBUG5				5
+
+void pr_log_pri(int, const char *, ...);
+void pr_log_debug(int, const char *, ...);
+
+int pr_trace_get_level(const char *);
+int pr_trace_msg(const char *, int, const char *, ...);
+
+/* Miscellaneous */
+void pr_signals_handle(void);
+int pr_str_is_boolean(const char *);
+int pr_fnmatch(const char *, const char *, int);
+
+#endif /* DBACL_BENCH_CONF_H */
@@ -0,0 +1,10 @@
+/*
+ * ProFTPD: mod_dbacl benchmark -- minimal stand-in for the ProFTPD core API
+ *
+ * mod_dbacl uses nothing from the ProFTPD privs.h API.
+ */
+
+#ifndef DBACL_BENCH_PRIVS_H
+#define DBACL_BENCH_PRIVS_H
+
+#endif /* DBACL_BENCH_PRIVS_H */
@@ -0,0 +1,877 @@
+/*
+ * ProFTPD: mod_dbacl benchmark -- minimal stand-in for the ProFTPD core API
+ * Copyright (c) 2025 TJ Saunders
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "conf.h"
+
+pool *permanent_pool = NULL;
+server_rec *main_server = NULL;
+session_t session;
+
+unsigned long bench_pool_nallocs = 0;
+unsigned long bench_pool_nbytes = 0;
+
+/* Pools
+ *
+ * As with ProFTPD's pools, allocations are carved out of blocks, and only
+ * freed when the pool (and its sub-pools) are destroyed.
+ */
+
+#define BENCH_POOL_BLOCK_SIZE		512
+#define BENCH_POOL_ALIGN		sizeof(union { void *p; long l; double d; })
+
+struct pool_block {
+  struct pool_block *next;
+  char *first_avail, *endp;
+};
+
+struct pool_rec {
+  struct pool_rec *parent, *sub_pools, *sub_next, *sub_prev;
+  struct pool_block *blocks;
+  const char *tag;
+};
+
+static struct pool_block *pool_block_new(size_t minsz) {
+  struct pool_block *blk;
+  size_t sz, hdrsz;
+
+  hdrsz = (sizeof(struct pool_block) + BENCH_POOL_ALIGN - 1) &
+    ~(BENCH_POOL_ALIGN - 1);
+
+  sz = BENCH_POOL_BLOCK_SIZE;
+  if (minsz > sz) {
+    sz = minsz;
+  }
+
+  blk = malloc(hdrsz + sz);
+  if (blk == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  blk->next = NULL;
+  blk->first_avail = ((char *) blk) + hdrsz;
+  blk->endp = blk->first_avail + sz;
+
+  return blk;
+}
+
+pool *make_sub_pool(pool *parent) {
+  pool *p;
+
+  p = calloc(1, sizeof(pool));
+  if (p == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  p->blocks = pool_block_new(0);
+
+  if (parent != NULL) {
+    p->parent = parent;
+    p->sub_next = parent->sub_pools;
+    if (parent->sub_pools != NULL) {
+      parent->sub_pools->sub_prev = p;
+    }
+    parent->sub_pools = p;
+  }
+
+  return p;
+}
+
+void destroy_pool(pool *p) {
+  struct pool_block *blk;
+
+  if (p == NULL) {
+    return;
+  }
+
+  while (p->sub_pools != NULL) {
+    destroy_pool(p->sub_pools);
+  }
+
+  if (p->parent != NULL) {
+    if (p->sub_prev != NULL) {
+      p->sub_prev->sub_next = p->sub_next;
+
+    } else {
+      p->parent->sub_pools = p->sub_next;
+    }
+
+    if (p->sub_next != NULL) {
+      p->sub_next->sub_prev = p->sub_prev;
+    }
+  }
+
+  blk = p->blocks;
+  while (blk != NULL) {
+    struct pool_block *next;
+
+    next = blk->next;
+    free(blk);
+    blk = next;
+  }
+
+  free(p);
+}
+
+void pr_pool_tag(pool *p, const char *tag) {
+  p->tag = tag;
+}
+
+void *palloc(pool *p, size_t sz) {
+  struct pool_block *blk;
+  char *ptr;
+
+  sz = (sz + BENCH_POOL_ALIGN - 1) & ~(BENCH_POOL_ALIGN - 1);
+  if (sz == 0) {
+    sz = BENCH_POOL_ALIGN;
+  }
+
+  bench_pool_nallocs++;
+  bench_pool_nbytes += sz;
+
+  blk = p->blocks;
+  if ((size_t) (blk->endp - blk->first_avail) < sz) {
+    blk = pool_block_new(sz);
+    blk->next = p->blocks;
+    p->blocks = blk;
+  }
+
+  ptr = blk->first_avail;
+  blk->first_avail += sz;
+
+  return ptr;
+}
+
+void *pcalloc(pool *p, size_t sz) {
+  void *ptr;
+
+  ptr = palloc(p, sz);
+  memset(ptr, 0, sz);
+
+  return ptr;
+}
+
+char *pstrdup(pool *p, const char *str) {
+  if (str == NULL) {
+    return NULL;
+  }
+
+  return pstrndup(p, str, strlen(str));
+}
+
+char *pstrndup(pool *p, const char *str, size_t n) {
+  char *res;
+  size_t len;
+
+  if (str == NULL) {
+    return NULL;
+  }
+
+  for (len = 0; len < n && str[len] != '\0'; len++);
+
+  res = palloc(p, len + 1);
+  memcpy(res, str, len);
+  res[len] = '\0';
+
+  return res;
+}
+
+char *pstrcat(pool *p, ...) {
+  char *argp, *ptr, *res;
+  size_t len = 0;
+  va_list ap;
+
+  va_start(ap, p);
+  while ((argp = va_arg(ap, char *)) != NULL) {
+    len += strlen(argp);
+  }
+  va_end(ap);
+
+  res = ptr = palloc(p, len + 1);
+
+  va_start(ap, p);
+  while ((argp = va_arg(ap, char *)) != NULL) {
+    size_t arglen;
+
+    arglen = strlen(argp);
+    memcpy(ptr, argp, arglen);
+    ptr += arglen;
+  }
+  va_end(ap);
+
+  *ptr = '\0';
+  return res;
+}
+
+char *pdircat(pool *p, ...) {
+  char *argp, *res;
+  size_t len = 0;
+  va_list ap;
+
+  va_start(ap, p);
+  while ((argp = va_arg(ap, char *)) != NULL) {
+    len += strlen(argp) + 1;
+  }
+  va_end(ap);
+
+  res = palloc(p, len + 1);
+  *res = '\0';
+
+  va_start(ap, p);
+  while ((argp = va_arg(ap, char *)) != NULL) {
+    size_t reslen;
+
+    reslen = strlen(res);
+    if (reslen > 0 &&
+        res[reslen-1] != '/' &&
+        *argp != '/') {
+      strcat(res, "/");
+
+    } else if (reslen > 0 &&
+               res[reslen-1] == '/' &&
+               *argp == '/') {
+      argp++;
+    }
+
+    strcat(res, argp);
+  }
+  va_end(ap);
+
+  return res;
+}
+
+array_header *make_array(pool *p, unsigned int nelts, size_t elt_size) {
+  array_header *arr;
+
+  if (nelts < 1) {
+    nelts = 1;
+  }
+
+  arr = palloc(p, sizeof(array_header));
+  arr->pool = p;
+  arr->elt_size = elt_size;
+  arr->nelts = 0;
+  arr->nalloc = nelts;
+  arr->elts = pcalloc(p, nelts * elt_size);
+
+  return arr;
+}
+
+void *push_array(array_header *arr) {
+  if (arr->nelts == arr->nalloc) {
+    void *elts;
+
+    elts = pcalloc(arr->pool, arr->nalloc * 2 * arr->elt_size);
+    memcpy(elts, arr->elts, arr->nalloc * arr->elt_size);
+    arr->elts = elts;
+    arr->nalloc *= 2;
+  }
+
+  return ((char *) arr->elts) + (arr->elt_size * arr->nelts++);
+}
+
+/* Tables
+ *
+ * Chained hash tables, with the same semantics as ProFTPD's: duplicate keys
+ * are rejected, and a table may be limited to a maximum number of entries.
+ */
+
+#define BENCH_TABLE_DEFAULT_NCHAINS	32
+
+struct table_entry {
+  struct table_entry *next;
+  const void *key;
+  size_t keysz;
+  unsigned int hash;
+  const void *value;
+  size_t valuesz;
+};
+
+struct table_rec {
+  pool *pool;
+  struct table_entry **chains;
+  unsigned int nchains, nents, max_ents;
+  struct table_entry *free_ents;
+};
+
+static unsigned int table_hash(const void *key, size_t keysz) {
+  const unsigned char *ptr = key;
+  unsigned int h = 5381;
+  size_t i;
+
+  for (i = 0; i < keysz; i++) {
+    h = (h * 33) + ptr[i];
+  }
+
+  return h;
+}
+
+pr_table_t *pr_table_nalloc(pool *p, int flags, unsigned int nchains) {
+  pr_table_t *tab;
+
+  if (nchains == 0) {
+    nchains = BENCH_TABLE_DEFAULT_NCHAINS;
+  }
+
+  tab = pcalloc(p, sizeof(pr_table_t));
+  tab->pool = p;
+  tab->nchains = nchains;
+  tab->chains = pcalloc(p, nchains * sizeof(struct table_entry *));
+  tab->max_ents = 8192;
+
+  return tab;
+}
+
+pr_table_t *pr_table_alloc(pool *p, int flags) {
+  return pr_table_nalloc(p, flags, 0);
+}
+
+static struct table_entry *table_find(pr_table_t *tab, const void *key,
+    size_t keysz, unsigned int hash, struct table_entry ***prevp) {
+  struct table_entry **prev, *ent;
+
+  prev = &(tab->chains[hash % tab->nchains]);
+  for (ent = *prev; ent != NULL; prev = &(ent->next), ent = ent->next) {
+    if (ent->hash == hash &&
+        ent->keysz == keysz &&
+        memcmp(ent->key, key, keysz) == 0) {
+      if (prevp != NULL) {
+        *prevp = prev;
+      }
+
+      return ent;
+    }
+  }
+
+  return NULL;
+}
+
+int pr_table_kadd(pr_table_t *tab, const void *key, size_t keysz,
+    const void *value, size_t valuesz) {
+  struct table_entry *ent;
+  unsigned int hash;
+
+  if (tab == NULL ||
+      key == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  hash = table_hash(key, keysz);
+  if (table_find(tab, key, keysz, hash, NULL) != NULL) {
+    errno = EEXIST;
+    return -1;
+  }
+
+  if (tab->nents == tab->max_ents) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  if (tab->free_ents != NULL) {
+    ent = tab->free_ents;
+    tab->free_ents = ent->next;
+
+  } else {
+    ent = palloc(tab->pool, sizeof(struct table_entry));
+  }
+
+  ent->key = key;
+  ent->keysz = keysz;
+  ent->hash = hash;
+  ent->value = value;
+  ent->valuesz = valuesz;
+
+  ent->next = tab->chains[hash % tab->nchains];
+  tab->chains[hash % tab->nchains] = ent;
+  tab->nents++;
+
+  return 0;
+}
+
+int pr_table_add(pr_table_t *tab, const char *key, const void *value,
+    size_t valuesz) {
+  return pr_table_kadd(tab, key, strlen(key) + 1, value, valuesz);
+}
+
+const void *pr_table_kget(pr_table_t *tab, const void *key, size_t keysz,
+    size_t *valuesz) {
+  struct table_entry *ent;
+
+  if (tab == NULL ||
+      key == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  ent = table_find(tab, key, keysz, table_hash(key, keysz), NULL);
+  if (ent == NULL) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  if (valuesz != NULL) {
+    *valuesz = ent->valuesz;
+  }
+
+  return ent->value;
+}
+
+const void *pr_table_get(pr_table_t *tab, const char *key, size_t *valuesz) {
+  return pr_table_kget(tab, key, strlen(key) + 1, valuesz);
+}
+
+const void *pr_table_kremove(pr_table_t *tab, const void *key, size_t keysz,
+    size_t *valuesz) {
+  struct table_entry *ent, **prev = NULL;
+
+  if (tab == NULL ||
+      key == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  ent = table_find(tab, key, keysz, table_hash(key, keysz), &prev);
+  if (ent == NULL) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  *prev = ent->next;
+  tab->nents--;
+
+  ent->next = tab->free_ents;
+  tab->free_ents = ent;
+
+  if (valuesz != NULL) {
+    *valuesz = ent->valuesz;
+  }
+
+  return ent->value;
+}
+
+const void *pr_table_remove(pr_table_t *tab, const char *key,
+    size_t *valuesz) {
+  return pr_table_kremove(tab, key, strlen(key) + 1, valuesz);
+}
+
+int pr_table_count(pr_table_t *tab) {
+  if (tab == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return (int) tab->nents;
+}
+
+int pr_table_ctl(pr_table_t *tab, int cmd, void *arg) {
+  if (tab == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (cmd == PR_TABLE_CTL_SET_MAX_ENTS) {
+    unsigned int max_ents;
+
+    max_ents = *((unsigned int *) arg);
+    if (max_ents < tab->nents) {
+      errno = EPERM;
+      return -1;
+    }
+
+    tab->max_ents = max_ents;
+    return 0;
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
+/* Configuration */
+
+static config_rec *config_add(xaset_t **set, const char *name,
+    unsigned int argc) {
+  config_rec *c;
+  pool *p;
+
+  if (*set == NULL) {
+    *set = pcalloc(main_server->pool, sizeof(xaset_t));
+  }
+
+  p = make_sub_pool(main_server->pool);
+
+  c = pcalloc(p, sizeof(config_rec));
+  c->pool = p;
+  c->config_type = CONF_PARAM;
+  c->name = pstrdup(p, name);
+  c->argc = argc;
+  c->argv = pcalloc(p, (argc + 1) * sizeof(void *));
+
+  c->prev = (*set)->tail;
+  if ((*set)->tail != NULL) {
+    (*set)->tail->next = c;
+
+  } else {
+    (*set)->head = c;
+  }
+  (*set)->tail = c;
+
+  return c;
+}
+
+config_rec *add_config_param_set(xaset_t **set, const char *name,
+    unsigned int argc, ...) {
+  config_rec *c;
+  unsigned int i;
+  va_list ap;
+
+  c = config_add(set, name, argc);
+
+  va_start(ap, argc);
+  for (i = 0; i < argc; i++) {
+    c->argv[i] = va_arg(ap, void *);
+  }
+  va_end(ap);
+
+  return c;
+}
+
+config_rec *add_config_param(const char *name, unsigned int argc, ...) {
+  config_rec *c;
+  unsigned int i;
+  va_list ap;
+
+  c = config_add(&(main_server->conf), name, argc);
+
+  va_start(ap, argc);
+  for (i = 0; i < argc; i++) {
+    c->argv[i] = va_arg(ap, void *);
+  }
+  va_end(ap);
+
+  return c;
+}
+
+config_rec *add_config_param_str(const char *name, unsigned int argc, ...) {
+  config_rec *c;
+  unsigned int i;
+  va_list ap;
+
+  c = config_add(&(main_server->conf), name, argc);
+
+  va_start(ap, argc);
+  for (i = 0; i < argc; i++) {
+    c->argv[i] = pstrdup(c->pool, va_arg(ap, char *));
+  }
+  va_end(ap);
+
+  return c;
+}
+
+config_rec *find_config_next(config_rec *prev, config_rec *c, int type,
+    const char *name, int recurse) {
+  for (; c != NULL; c = c->next) {
+    if ((type == -1 || c->config_type == type) &&
+        (name == NULL || strcmp(c->name, name) == 0)) {
+      return c;
+    }
+  }
+
+  return NULL;
+}
+
+config_rec *find_config(xaset_t *set, int type, const char *name,
+    int recurse) {
+  if (set == NULL) {
+    return NULL;
+  }
+
+  return find_config_next(NULL, set->head, type, name, recurse);
+}
+
+int get_boolean(cmd_rec *cmd, int argn) {
+  return pr_str_is_boolean(cmd->argv[argn]);
+}
+
+/* Modules */
+
+modret_t *mod_create_ret(cmd_rec *cmd, unsigned char err, const char *numeric,
+    const char *msg) {
+  modret_t *mr;
+
+  mr = pcalloc(cmd->tmp_pool, sizeof(modret_t));
+  mr->mr_error = err;
+  mr->mr_numeric = (char *) numeric;
+  mr->mr_message = (char *) msg;
+
+  return mr;
+}
+
+modret_t *mod_create_data(cmd_rec *cmd, void *data) {
+  modret_t *mr;
+
+  mr = mod_create_ret(cmd, 0, NULL, NULL);
+  mr->data = data;
+
+  return mr;
+}
+
+modret_t *pr_module_call(module *m, modret_t *(*func)(cmd_rec *),
+    cmd_rec *cmd) {
+  return func(cmd);
+}
+
+/* The benchmark's SQL hooks are backed by SQLite, so mod_sql_sqlite is the
+ * only SQL backend module "loaded".
+ */
+module *pr_module_get(const char *name) {
+  static module sqlite_module;
+
+  if (strcmp(name, "mod_sql_sqlite.c") == 0) {
+    return &sqlite_module;
+  }
+
+  errno = ENOENT;
+  return NULL;
+}
+
+#define BENCH_STASH_MAX_SYMBOLS		16
+
+static cmdtable *stash_hooks[BENCH_STASH_MAX_SYMBOLS];
+static unsigned int stash_nhooks = 0;
+
+int pr_stash_add_symbol(pr_stash_type_t type, void *data) {
+  if (type != PR_SYM_HOOK ||
+      stash_nhooks == BENCH_STASH_MAX_SYMBOLS) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  stash_hooks[stash_nhooks++] = data;
+  return 0;
+}
+
+void *pr_stash_get_symbol(pr_stash_type_t type, const char *name,
+    void *prev, int *idx_cache) {
+  unsigned int i;
+
+  if (type != PR_SYM_HOOK) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  for (i = 0; i < stash_nhooks; i++) {
+    if (strcmp(stash_hooks[i]->command, name) == 0) {
+      return stash_hooks[i];
+    }
+  }
+
+  errno = ENOENT;
+  return NULL;
+}
+
+/* Commands */
+
+static const char *cmd_names[] = {
+  NULL,
+  C_APPE, C_CDUP, C_CWD, C_DELE, C_LIST, C_MDTM, C_MFF, C_MFMT, C_MKD, C_MLSD,
+  C_MLST, C_NLST, C_PASS, C_PWD, C_RETR, C_RMD, C_RNFR, C_RNTO, C_SITE, C_SIZE,
+  C_STAT, C_STOR, C_STOU, C_XCUP, C_XCWD, C_XMKD, C_XPWD, C_XRMD,
+  NULL
+};
+
+int pr_cmd_get_id(const char *name) {
+  unsigned int i;
+
+  for (i = 1; cmd_names[i] != NULL; i++) {
+    if (strcasecmp(cmd_names[i], name) == 0) {
+      return (int) i;
+    }
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
+int pr_cmd_cmp(cmd_rec *cmd, int cmd_id) {
+  if (cmd->cmd_id == 0) {
+    cmd->cmd_id = pr_cmd_get_id(cmd->argv[0]);
+  }
+
+  if (cmd->cmd_id == cmd_id) {
+    return 0;
+  }
+
+  return cmd->cmd_id < cmd_id ? -1 : 1;
+}
+
+int pr_cmd_strcmp(cmd_rec *cmd, const char *name) {
+  return strcasecmp(cmd->argv[0], name);
+}
+
+void pr_response_add(const char *numeric, const char *fmt, ...) {
+}
+
+void pr_response_add_err(const char *numeric, const char *fmt, ...) {
+}
+
+/* Session */
+
+const char *pr_session_get_protocol(int flags) {
+  return "ftp";
+}
+
+/* Filesystem
+ *
+ * The session's current directory is always the root directory.
+ */
+
+pr_fs_t *pr_register_fs(pool *p, const char *name, const char *path) {
+  pr_fs_t *fs;
+
+  fs = pcalloc(p, sizeof(pr_fs_t));
+  fs->fs_name = pstrdup(p, name);
+  fs->fs_path = pstrdup(p, path);
+
+  return fs;
+}
+
+const char *pr_fs_getcwd(void) {
+  return "/";
+}
+
+int pr_fs_valid_path(const char *path) {
+  if (path != NULL &&
+      *path == '/') {
+    return 0;
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
+char *dir_abs_path(pool *p, const char *path, int interpolate) {
+  if (path == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (*path == '/') {
+    return pstrdup(p, path);
+  }
+
+  return pdircat(p, pr_fs_getcwd(), path, NULL);
+}
+
+/* Events */
+
+#define BENCH_EVENT_MAX_HANDLERS	16
+
+static struct {
+  const char *name;
+  void (*cb)(const void *, void *);
+  void *user_data;
+} event_handlers[BENCH_EVENT_MAX_HANDLERS];
+static unsigned int event_nhandlers = 0;
+
+int pr_event_register(module *m, const char *name,
+    void (*cb)(const void *, void *), void *user_data) {
+  if (event_nhandlers == BENCH_EVENT_MAX_HANDLERS) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  event_handlers[event_nhandlers].name = name;
+  event_handlers[event_nhandlers].cb = cb;
+  event_handlers[event_nhandlers].user_data = user_data;
+  event_nhandlers++;
+
+  return 0;
+}
+
+void pr_event_generate(const char *name, const void *event_data) {
+  unsigned int i;
+
+  for (i = 0; i < event_nhandlers; i++) {
+    if (strcmp(event_handlers[i].name, name) == 0) {
+      (event_handlers[i].cb)(event_data, event_handlers[i].user_data);
+    }
+  }
+}
+
+/* Logging
+ *
+ * Log messages go to stderr; trace messages are discarded, as they would
+ * be with no Trace configured.
+ */
+
+void pr_log_pri(int prio, const char *fmt, ...) {
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+
+  fputc('\n', stderr);
+}
+
+void pr_log_debug(int level, const char *fmt, ...) {
+}
+
+int pr_trace_get_level(const char *channel) {
+  return -1;
+}
+
+int pr_trace_msg(const char *channel, int level, const char *fmt, ...) {
+  return 0;
+}
+
+/* Miscellaneous */
+
+void pr_signals_handle(void) {
+}
+
+int pr_fnmatch(const char *pattern, const char *str, int flags) {
+  return fnmatch(pattern, str, flags);
+}
+
+int pr_str_is_boolean(const char *str) {
+  if (str == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (strcasecmp(str, "on") == 0 ||
+      strcasecmp(str, "yes") == 0 ||
+      strcasecmp(str, "true") == 0 ||
+      strcasecmp(str, "1") == 0) {
+    return TRUE;
+  }
+
+  if (strcasecmp(str, "off") == 0 ||
+      strcasecmp(str, "no") == 0 ||
+      strcasecmp(str, "false") == 0 ||
+      strcasecmp(str, "0") == 0) {
+    return FALSE;
+  }
+
+  errno = EINVAL;
+  return -1;
+}
@@ -0,0 +1,845 @@
+package ProFTPD::Tests::Modules::mod_dbacl::scale;
+
+# Scalability tests: large ACL tables, deep paths, and concurrent FTP and
+# SFTP sessions running a mix of commands.  The commands/sec and per-command
+# latencies are reported, but not checked, as they depend on the machine; only
+# the SQL queries per ACL lookup are compared against the stored baselines
+# (see t/etc/modules/mod_dbacl/scale-baselines.txt), and the test fails if
+# they have regressed.
+#
+# These tests are slow, and are not run by t/modules/mod_dbacl.t; run them
+# using t/modules/mod_dbacl/scale.t.  The following environment variables
+# configure them:
+#
+#  PROFTPD_TEST_DBACL_SCALE_ROWS       Rows in the ACL table (default 100000)
+#  PROFTPD_TEST_DBACL_SCALE_DEPTH      Depth of the directory tree (default 60)
+#  PROFTPD_TEST_DBACL_SCALE_CLIENTS    Concurrent clients, half of them FTP and
+#                                      half SFTP (default 8)
+#  PROFTPD_TEST_DBACL_SCALE_COMMANDS   Commands per client (default 200)
+#  PROFTPD_TEST_DBACL_SCALE_BASELINES  Baselines file
+#  PROFTPD_TEST_DBACL_SCALE_RECORD     If set, the SQL queries per lookup are
+#                                      written to the baselines file, rather
+#                                      than checked
+#
+# Baselines are kept per scenario, table size, depth and clients, as the
+# results depend on them; results for which there is no baseline are
+# reported, but not checked.  The baselines for the default parameters are
+# shipped, and kept when recording.
+
+use lib qw(t/lib);
+use base qw(ProFTPD::TestSuite::Child);
+use strict;
+
+use File::Path qw(mkpath);
+use File::Spec;
+use IO::Handle;
+use POSIX qw(:fcntl_h);
+use Time::HiRes qw(gettimeofday tv_interval);
+
+use ProFTPD::TestSuite::FTP;
+use ProFTPD::TestSuite::Utils qw(:auth :config :running :test :testsuite);
+
+$| = 1;
+
+my $order = 0;
+
+my $TESTS = {
+  dbacl_scale_default => {
+    order => ++$order,
+    test_class => [qw(forking mod_sftp sftp slow)],
+  },
+
+  dbacl_scale_cached => {
+    order => ++$order,
+    test_class => [qw(forking mod_sftp sftp slow)],
+  },
+
+};
+
+sub new {
+  return shift()->SUPER::new(@_);
+}
+
+sub list_tests {
+  return testsuite_get_runnable_tests($TESTS);
+}
+
+sub set_up {
+  my $self = shift;
+  $self->SUPER::set_up(@_);
+
+  # Make sure that mod_sftp does not complain about permissions on the hostkey
+  # files.
+
+  my $rsa_host_key = File::Spec->rel2abs("$ENV{PROFTPD_TEST_DIR}/t/etc/modules/mod_sftp/ssh_host_rsa_key");
+  my $dsa_host_key = File::Spec->rel2abs("$ENV{PROFTPD_TEST_DIR}/t/etc/modules/mod_sftp/ssh_host_dsa_key");
+
+  unless (chmod(0400, $rsa_host_key, $dsa_host_key)) {
+    die("Can't set perms on $rsa_host_key, $dsa_host_key: $!");
+  }
+}
+
+sub scale_get_params {
+  my $params = {
+    rows => $ENV{PROFTPD_TEST_DBACL_SCALE_ROWS} || 100000,
+    depth => $ENV{PROFTPD_TEST_DBACL_SCALE_DEPTH} || 60,
+    clients => $ENV{PROFTPD_TEST_DBACL_SCALE_CLIENTS} || 8,
+    commands => $ENV{PROFTPD_TEST_DBACL_SCALE_COMMANDS} || 200,
+    baselines => $ENV{PROFTPD_TEST_DBACL_SCALE_BASELINES} ||
+      File::Spec->rel2abs("$ENV{PROFTPD_TEST_DIR}/t/etc/modules/mod_dbacl/scale-baselines.txt"),
+  };
+
+  # Files are created every 10 levels, so the tree must have at least one
+  # such level.
+  if ($params->{depth} < 10) {
+    $params->{depth} = 10;
+  }
+
+  if ($params->{clients} < 2) {
+    $params->{clients} = 2;
+  }
+
+  return $params;
+}
+
+sub scale_get_dir {
+  my $home_dir = shift;
+  my $level = shift;
+
+  return "$home_dir/deep" . join('', map { sprintf("/l%02d", $_) } (1..$level));
+}
+
+# Writes the SQL script for the ACL table: rows for some of the directories
+# along the deep tree (level 1, then every 7th level), a denying row for one
+# file in each directory with files, rows for siblings of the tree's
+# directories at every level, and the remaining rows for other, unrelated
+# subtrees, as for other users.
+sub scale_write_db_script {
+  my $db_script = shift;
+  my $home_dir = shift;
+  my $params = shift;
+
+  my $depth = $params->{depth};
+  my $nrows = 0;
+
+  my $fh;
+  unless (open($fh, "> $db_script")) {
+    die("Can't open $db_script: $!");
+  }
+
+  print $fh <<EOS;
+CREATE TABLE ftpacl (
+  path TEXT NOT NULL,
+  read_acl TEXT,
+  write_acl TEXT,
+  delete_acl TEXT,
+  create_acl TEXT,
+  modify_acl TEXT,
+  move_acl TEXT,
+  view_acl TEXT,
+  navigate_acl TEXT
+);
+
+BEGIN;
+EOS
+
+  for (my $level = 1; $level <= $depth; $level++) {
+    my $dir = scale_get_dir($home_dir, $level);
+
+    if ($level == 1 ||
+        $level % 7 == 0) {
+      print $fh "INSERT INTO ftpacl VALUES ('$dir', 'true', 'true', 'true', 'true', 'true', 'true', 'true', 'true');\n";
+      $nrows++;
+    }
+
+    if ($level % 10 == 0) {
+      print $fh "INSERT INTO ftpacl (path, read_acl) VALUES ('$dir/f5.txt', 'false');\n";
+      $nrows++;
+    }
+  }
+
+  my $nsiblings = int(($params->{rows} / 10) / $depth);
+  if ($nsiblings > 0) {
+    for (my $level = 1; $level <= $depth; $level++) {
+      my $dir = scale_get_dir($home_dir, $level - 1);
+
+      print $fh <<EOS;
+INSERT INTO ftpacl (path, read_acl, view_acl, navigate_acl)
+  WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM seq WHERE n < $nsiblings)
+  SELECT '$dir/s' || n, CASE WHEN n % 2 = 0 THEN 'false' ELSE 'true' END, 'true', 'true' FROM seq;
+EOS
+      $nrows += $nsiblings;
+    }
+  }
+
+  my $nbulk = $params->{rows} - $nrows;
+  if ($nbulk > 0) {
+    print $fh <<EOS;
+INSERT INTO ftpacl (path, read_acl, write_acl, view_acl, navigate_acl)
+  WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM seq WHERE n < $nbulk)
+  SELECT '$home_dir/noise/u' || (n % 1000) || '/d' || ((n / 1000) % 100) || '/f' || n,
+    CASE WHEN n % 3 = 0 THEN 'false' ELSE 'true' END, 'true', 'true', 'true' FROM seq;
+EOS
+  }
+
+  print $fh <<EOS;
+COMMIT;
+
+CREATE INDEX ftpacl_path_idx ON ftpacl (path);
+EOS
+
+  unless (close($fh)) {
+    die("Can't write $db_script: $!");
+  }
+}
+
+# Creates the deep directory tree, with files every 10 levels.
+sub scale_create_tree {
+  my $home_dir = shift;
+  my $params = shift;
+  my $uid = shift;
+  my $gid = shift;
+
+  my $depth = $params->{depth};
+  my $deepest = scale_get_dir($home_dir, $depth);
+
+  mkpath($deepest);
+
+  for (my $level = 10; $level <= $depth; $level += 10) {
+    my $dir = scale_get_dir($home_dir, $level);
+
+    for (my $i = 1; $i <= 5; $i++) {
+      my $test_file = "$dir/f$i.txt";
+
+      if (open(my $fh, "> $test_file")) {
+        print $fh "Hello, World!\n";
+        unless (close($fh)) {
+          die("Can't write $test_file: $!");
+        }
+
+      } else {
+        die("Can't open $test_file: $!");
+      }
+    }
+  }
+
+  if ($< == 0) {
+    for (my $level = 0; $level <= $depth; $level++) {
+      my $dir = $level > 0 ? scale_get_dir($home_dir, $level) : "$home_dir/deep";
+
+      unless (chmod(0755, $dir)) {
+        die("Can't set perms on $dir to 0755: $!");
+      }
+
+      unless (chown($uid, $gid, $dir)) {
+        die("Can't set owner of $dir to $uid/$gid: $!");
+      }
+    }
+  }
+}
+
+# Returns a random file (f1.txt to f5.txt, f5.txt being denied), in a random
+# directory with files.
+sub scale_get_file {
+  my $home_dir = shift;
+  my $params = shift;
+
+  my $nlevels = int($params->{depth} / 10);
+  my $level = (int(rand($nlevels)) + 1) * 10;
+  my $i = int(rand(5)) + 1;
+
+  return scale_get_dir($home_dir, $level) . "/f$i.txt";
+}
+
+sub scale_time_op {
+  my $results = shift;
+  my $op = shift;
+  my $code = shift;
+
+  my $start = [gettimeofday()];
+  my $ok = eval { $code->() };
+  my $elapsed_ms = tv_interval($start) * 1000.0;
+
+  push(@$results, sprintf("%s %.3f %d", $op, $elapsed_ms, $ok ? 0 : 1));
+}
+
+sub scale_run_ftp_client {
+  my $port = shift;
+  my $user = shift;
+  my $passwd = shift;
+  my $home_dir = shift;
+  my $params = shift;
+  my $id = shift;
+  my $results = shift;
+
+  my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port);
+  $client->login($user, $passwd);
+
+  for (my $i = 0; $i < $params->{commands}; $i++) {
+    my $n = rand(100);
+
+    if ($n < 30) {
+      my $path = scale_get_file($home_dir, $params);
+      scale_time_op($results, 'SIZE', sub { $client->size($path); 1 });
+
+    } elsif ($n < 50) {
+      my $path = scale_get_file($home_dir, $params);
+      scale_time_op($results, 'MDTM', sub { $client->mdtm($path); 1 });
+
+    } elsif ($n < 70) {
+      my $path = scale_get_file($home_dir, $params);
+      scale_time_op($results, 'RETR', sub {
+        my $conn = $client->retr_raw($path);
+        return 0 unless $conn;
+
+        my $buf;
+        $conn->read($buf, 8192, 25);
+        eval { $conn->close() };
+        1;
+      });
+
+    } elsif ($n < 90) {
+      my $level = int(rand($params->{depth})) + 1;
+      my $path = scale_get_dir($home_dir, $level);
+      scale_time_op($results, 'CWD', sub { $client->cwd($path); 1 });
+
+    } else {
+      my $path = scale_get_dir($home_dir, $params->{depth}) . "/up-$id-$i.txt";
+      scale_time_op($results, 'STOR', sub {
+        my $conn = $client->stor_raw($path);
+        return 0 unless $conn;
+
+        my $buf = "Hello, World!\n";
+        $conn->write($buf, length($buf), 25);
+        eval { $conn->close() };
+        1;
+      });
+
+      scale_time_op($results, 'DELE', sub { $client->dele($path); 1 });
+    }
+  }
+
+  # The ACL lookups and SQL queries made by this session; the "sql" phase is
+  # the fourth phase reported.
+  $client->site('DBACL', 'STATS');
+
+  my $lookups = $client->response_msg(0);
+  if ($lookups =~ /^ACL lookups: (\d+) allowed, (\d+) denied, (\d+) unresolved/) {
+    push(@$results, "lookups " . ($1 + $2 + $3));
+  }
+
+  my $queries = $client->response_msg(4);
+  if ($queries =~ /^sql: (\d+) calls/) {
+    push(@$results, "queries $1");
+  }
+
+  $client->quit();
+}
+
+sub scale_run_sftp_client {
+  my $port = shift;
+  my $user = shift;
+  my $passwd = shift;
+  my $home_dir = shift;
+  my $params = shift;
+  my $id = shift;
+  my $results = shift;
+
+  require Net::SSH2;
+
+  my $ssh2 = Net::SSH2->new();
+
+  unless ($ssh2->connect('127.0.0.1', $port)) {
+    my ($err_code, $err_name, $err_str) = $ssh2->error();
+    die("Can't connect to SSH2 server: [$err_name] ($err_code) $err_str");
+  }
+
+  unless ($ssh2->auth_password($user, $passwd)) {
+    my ($err_code, $err_name, $err_str) = $ssh2->error();
+    die("Can't login to SSH2 server: [$err_name] ($err_code) $err_str");
+  }
+
+  my $sftp = $ssh2->sftp();
+  unless ($sftp) {
+    my ($err_code, $err_name, $err_str) = $ssh2->error();
+    die("Can't use SFTP on SSH2 server: [$err_name] ($err_code) $err_str");
+  }
+
+  for (my $i = 0; $i < $params->{commands}; $i++) {
+    my $n = rand(100);
+
+    if ($n < 35) {
+      my $path = scale_get_file($home_dir, $params);
+      scale_time_op($results, 'STAT', sub { $sftp->stat($path, 1) ? 1 : 0 });
+
+    } elsif ($n < 55) {
+      my $path = scale_get_file($home_dir, $params);
+      scale_time_op($results, 'LSTAT', sub { $sftp->stat($path, 0) ? 1 : 0 });
+
+    } elsif ($n < 85) {
+      my $path = scale_get_file($home_dir, $params);
+      scale_time_op($results, 'OPEN', sub {
+        my $fh = $sftp->open($path, O_RDONLY);
+        return 0 unless $fh;
+
+        my $buf;
+        while ($fh->read($buf, 8192)) {
+        }
+
+        # To issue the FXP_CLOSE, we have to explicitly destroy the
+        # filehandle
+        $fh = undef;
+        1;
+      });
+
+    } else {
+      my $level = (int(rand(int($params->{depth} / 10))) + 1) * 10;
+      my $path = scale_get_dir($home_dir, $level);
+      scale_time_op($results, 'READDIR', sub {
+        my $dir = $sftp->opendir($path);
+        return 0 unless $dir;
+
+        while ($dir->read()) {
+        }
+
+        $dir = undef;
+        1;
+      });
+    }
+  }
+
+  # To close the SFTP channel, we have to explicitly destroy the object
+  $sftp = undef;
+
+  $ssh2->disconnect();
+}
+
+# Runs the clients concurrently, each in its own process, and collects their
+# results.
+sub scale_run_clients {
+  my $port = shift;
+  my $user = shift;
+  my $passwd = shift;
+  my $home_dir = shift;
+  my $params = shift;
+  my $tmpdir = shift;
+
+  # Reap the clients here, rather than in the test's SIGCHLD handler.
+  local $SIG{CHLD} = 'DEFAULT';
+
+  # Ignore SIGPIPE
+  local $SIG{PIPE} = sub { };
+
+  my $nftp = int($params->{clients} / 2);
+  my $pids = {};
+
+  my $start = [gettimeofday()];
+
+  for (my $id = 0; $id < $params->{clients}; $id++) {
+    my $results_file = "$tmpdir/client-$id.txt";
+
+    defined(my $pid = fork()) or die("Can't fork: $!");
+    if ($pid) {
+      $pids->{$pid} = $results_file;
+      next;
+    }
+
+    srand(1000 + $id);
+
+    my $results = [];
+    eval {
+      if ($id < $nftp) {
+        scale_run_ftp_client($port, $user, $passwd, $home_dir, $params, $id,
+          $results);
+
+      } else {
+        scale_run_sftp_client($port, $user, $passwd, $home_dir, $params, $id,
+          $results);
+      }
+    };
+
+    my $ex = $@;
+
+    if (open(my $fh, "> $results_file")) {
+      print $fh join("\n", @$results), "\n";
+      print $fh $ex ? "error $ex\n" : "done\n";
+      close($fh);
+    }
+
+    exit($ex ? 1 : 0);
+  }
+
+  foreach my $pid (keys(%$pids)) {
+    waitpid($pid, 0);
+  }
+
+  my $elapsed = tv_interval($start);
+
+  my $latencies = {};
+  my $ndenied = {};
+  my $ncommands = 0;
+  my $nlookups = 0;
+  my $nqueries = 0;
+
+  foreach my $results_file (values(%$pids)) {
+    my $fh;
+    unless (open($fh, "< $results_file")) {
+      die("Can't read $results_file: $!");
+    }
+
+    my $done = 0;
+    while (my $line = <$fh>) {
+      chomp($line);
+
+      if ($line eq 'done') {
+        $done = 1;
+
+      } elsif ($line =~ /^error (.*)$/) {
+        die("Client failed: $1");
+
+      } elsif ($line =~ /^lookups (\d+)$/) {
+        $nlookups += $1;
+
+      } elsif ($line =~ /^queries (\d+)$/) {
+        $nqueries += $1;
+
+      } elsif ($line =~ /^(\S+) (\S+) (\d)$/) {
+        push(@{ $latencies->{$1} }, $2);
+        $ndenied->{$1} += $3;
+        $ncommands++;
+      }
+    }
+
+    close($fh);
+
+    unless ($done) {
+      die("Client did not complete, see $results_file");
+    }
+  }
+
+  return {
+    elapsed => $elapsed,
+    commands => $ncommands,
+    lookups => $nlookups,
+    queries => $nqueries,
+    latencies => $latencies,
+    denied => $ndenied,
+  };
+}
+
+sub scale_get_percentile {
+  my $values = shift;
+  my $pct = shift;
+
+  my @sorted = sort { $a <=> $b } @$values;
+  return $sorted[int(($pct / 100) * $#sorted)];
+}
+
+sub scale_read_baselines {
+  my $baselines_file = shift;
+
+  my $baselines = {};
+
+  my $fh;
+  unless (open($fh, "< $baselines_file")) {
+    return $baselines;
+  }
+
+  while (my $line = <$fh>) {
+    chomp($line);
+
+    next if $line =~ /^\s*(#|$)/;
+
+    my ($key, $metric, $value) = split(/\s+/, $line);
+    $baselines->{$key}->{$metric} = $value;
+  }
+
+  close($fh);
+  return $baselines;
+}
+
+# Replaces the baselines for the given key and metrics with the given
+# values, keeping the comments and other baselines.
+sub scale_write_baselines {
+  my $baselines_file = shift;
+  my $key = shift;
+  my $metrics = shift;
+
+  my $lines = [];
+
+  if (open(my $fh, "< $baselines_file")) {
+    while (my $line = <$fh>) {
+      chomp($line);
+
+      my ($line_key, $line_metric) = split(/\s+/, $line);
+      next if defined($line_key) &&
+        $line_key eq $key &&
+        defined($line_metric) &&
+        exists($metrics->{$line_metric});
+
+      push(@$lines, $line);
+    }
+
+    close($fh);
+  }
+
+  foreach my $metric (sort(keys(%$metrics))) {
+    push(@$lines, sprintf("%s %s %.3f", $key, $metric, $metrics->{$metric}));
+  }
+
+  if (open(my $fh, "> $baselines_file")) {
+    print $fh join("\n", @$lines), "\n";
+    unless (close($fh)) {
+      die("Can't write $baselines_file: $!");
+    }
+
+  } else {
+    die("Can't open $baselines_file: $!");
+  }
+}
+
+# Reports the results, then checks the SQL queries per lookup against the
+# baselines (or records them as the new baselines).
+sub scale_check_results {
+  my $self = shift;
+  my $scenario = shift;
+  my $params = shift;
+  my $results = shift;
+
+  my $key = "$scenario-r$params->{rows}-d$params->{depth}-c$params->{clients}";
+  my $metrics = {};
+
+  if ($results->{lookups} > 0) {
+    $metrics->{sql_per_lookup} = $results->{queries} / $results->{lookups};
+  }
+
+  print STDERR "\n# mod_dbacl scale: $key\n";
+  printf STDERR "#   %d commands in %.1f secs, %.1f commands/sec",
+    $results->{commands}, $results->{elapsed},
+    $results->{commands} / $results->{elapsed};
+  if (defined($metrics->{sql_per_lookup})) {
+    printf STDERR ", %.2f SQL queries per FTP lookup",
+      $metrics->{sql_per_lookup};
+  }
+  print STDERR "\n";
+  printf STDERR "#   %-8s %8s %10s %10s %8s\n", 'command', 'count', 'p50 (ms)',
+    'p99 (ms)', 'denied';
+
+  foreach my $op (sort(keys(%{ $results->{latencies} }))) {
+    my $latencies = $results->{latencies}->{$op};
+    my $p50 = scale_get_percentile($latencies, 50);
+    my $p99 = scale_get_percentile($latencies, 99);
+
+    printf STDERR "#   %-8s %8d %10.2f %10.2f %8d\n", $op,
+      scalar(@$latencies), $p50, $p99, $results->{denied}->{$op};
+  }
+
+  if ($ENV{PROFTPD_TEST_DBACL_SCALE_RECORD}) {
+    # The shipped SQL queries per lookup are kept; the measured value depends
+    # on how many rows the concurrent sessions happened to share.
+    my $baseline = scale_read_baselines($params->{baselines})->{$key};
+    if ($baseline &&
+        defined($baseline->{sql_per_lookup})) {
+      delete($metrics->{sql_per_lookup});
+    }
+
+    if (scalar(keys(%$metrics)) > 0) {
+      scale_write_baselines($params->{baselines}, $key, $metrics);
+      print STDERR "#   recorded baselines in $params->{baselines}\n";
+    }
+
+    return;
+  }
+
+  my $baseline = scale_read_baselines($params->{baselines})->{$key};
+  unless ($baseline &&
+          defined($baseline->{sql_per_lookup}) &&
+          defined($metrics->{sql_per_lookup})) {
+    print STDERR "#   no baselines for $key, not checking results\n";
+    return;
+  }
+
+  # The number of queries does not depend on the machine, so any increase
+  # beyond noise from the random command mix is a regression.
+  my $expected = $baseline->{sql_per_lookup};
+  my $value = $metrics->{sql_per_lookup};
+
+  $self->assert($value <= ($expected * 1.05) + 0.05,
+    test_msg(sprintf("Results for %s regressed: sql_per_lookup: %.3f, " .
+      "baseline %.3f", $key, $value, $expected)));
+}
+
+sub scale_run {
+  my $self = shift;
+  my $scenario = shift;
+  my $dbacl_config = shift;
+  my $tmpdir = $self->{tmpdir};
+
+  my $params = scale_get_params();
+
+  my $config_file = "$tmpdir/dbacl.conf";
+  my $pid_file = File::Spec->rel2abs("$tmpdir/dbacl.pid");
+  my $scoreboard_file = File::Spec->rel2abs("$tmpdir/dbacl.scoreboard");
+
+  my $log_file = File::Spec->rel2abs('tests.log');
+
+  my $auth_user_file = File::Spec->rel2abs("$tmpdir/dbacl.passwd");
+  my $auth_group_file = File::Spec->rel2abs("$tmpdir/dbacl.group");
+
+  my $user = 'proftpd';
+  my $passwd = 'test';
+  my $group = 'ftpd';
+  my $home_dir = File::Spec->rel2abs($tmpdir);
+  my $uid = 500;
+  my $gid = 500;
+
+  my $db_file = File::Spec->rel2abs("$tmpdir/proftpd.db");
+
+  # Build up sqlite3 command to create tables and populate them
+  my $db_script = File::Spec->rel2abs("$tmpdir/proftpd.sql");
+
+  scale_write_db_script($db_script, $home_dir, $params);
+
+  my $cmd = "sqlite3 $db_file < $db_script";
+
+  if ($ENV{TEST_VERBOSE}) {
+    print STDERR "Executing sqlite3: $cmd\n";
+  }
+
+  my @output = `$cmd`;
+  if (scalar(@output) &&
+      $ENV{TEST_VERBOSE}) {
+    print STDERR "Output: ", join('', @output), "\n";
+  }
+
+  scale_create_tree($home_dir, $params, $uid, $gid);
+
+  # Make sure that, if we're running as root, the database file has
+  # the permissions/privs set for use by proftpd
+  if ($< == 0) {
+    unless (chmod(0666, $db_file)) {
+      die("Can't set perms on $db_file to 0666: $!");
+    }
+
+    unless (chmod(0755, $home_dir)) {
+      die("Can't set perms on $home_dir to 0755: $!");
+    }
+
+    unless (chown($uid, $gid, $home_dir)) {
+      die("Can't set owner of $home_dir to $uid/$gid: $!");
+    }
+  }
+
+  auth_user_write($auth_user_file, $user, $passwd, $uid, $gid, $home_dir,
+    '/bin/bash');
+  auth_group_write($auth_group_file, $group, $gid, $user);
+
+  my $rsa_host_key = File::Spec->rel2abs("$ENV{PROFTPD_TEST_DIR}/t/etc/modules/mod_sftp/ssh_host_rsa_key");
+  my $dsa_host_key = File::Spec->rel2abs("$ENV{PROFTPD_TEST_DIR}/t/etc/modules/mod_sftp/ssh_host_dsa_key");
+
+  # No tracing, as it would dominate the timings.
+  my $config = {
+    PidFile => $pid_file,
+    ScoreboardFile => $scoreboard_file,
+    SystemLog => $log_file,
+
+    AuthUserFile => $auth_user_file,
+    AuthGroupFile => $auth_group_file,
+    MaxInstances => $params->{clients} * 2,
+
+    IfModules => {
+      'mod_dbacl.c' => {
+        DBACLEngine => 'on',
+        %$dbacl_config,
+      },
+
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_sftp.c' => [
+        "SFTPEngine on",
+        "SFTPLog $log_file",
+        "SFTPHostKey $rsa_host_key",
+        "SFTPHostKey $dsa_host_key",
+      ],
+
+      'mod_sql.c' => {
+        SQLEngine => 'log',
+        SQLBackend => 'sqlite3',
+        SQLConnectInfo => $db_file,
+        SQLLogFile => $log_file,
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($config_file, $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      sleep(2);
+
+      my $results = scale_run_clients($port, $user, $passwd, $home_dir,
+        $params, $tmpdir);
+      $self->scale_check_results($scenario, $params, $results);
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($config_file, $rfh, 600) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($pid_file);
+
+  $self->assert_child_ok($pid);
+
+  if ($ex) {
+    die($ex);
+  }
+
+  unlink($log_file);
+}
+
+sub dbacl_scale_default {
+  my $self = shift;
+
+  $self->scale_run('default', {});
+}
+
+sub dbacl_scale_cached {
+  my $self = shift;
+
+  $self->scale_run('cached', {
+    DBACLCache => 'on',
+    DBACLSharedCache => 'on',
+    DBACLOptions => 'InheritDirectoryRows',
+  });
+}
+
+1;